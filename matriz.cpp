@@ -4,97 +4,576 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <sstream>
+#include <string.h>
+#include <math.h>
+#include <limits>
 
 #include "mpi.h"
+#include "matriz_kernels.h"
 
-#define N 2000 /* number of rows and columns in matrix */
+/* Usage: mpirun -np P ./matriz [-n N] [-kernel naive|generic|avx2|avx512|auto] [-panel W]
+ *                              [-precision f64|f32|mixed] [-check] [-verify S] [-freivalds R]
+ *                              [-a A.bin] [-b B.bin] [-o C.bin] [-write-inputs]
+ * N is chosen at run time (default 2000). Each rank allocates only what it holds:
+ * the master the full a and c; a worker its slab of a and c. b is stored once per node
+ * in a shared-memory window and only one leader per node receives it.
+ * The a slabs are scattered, b is broadcast in column panels of W columns (default
+ * 512) and c comes back panel by panel, overlapping transfers with the multiply; the
+ * master computes its own slab meanwhile, so -np 1 runs the whole product locally.
+ * Built with -fopenmp each rank runs the kernel on OMP_NUM_THREADS threads, e.g.
+ *   mpicxx -O3 -march=native -fopenmp matriz.cpp -o matriz
+ *   OMP_NUM_THREADS=12 mpirun -np 1 --bind-to none ./matriz   (one rank per node)
+ *   mpirun -np 2 --map-by ppr:1:numa --bind-to numa ./matriz (one rank per NUMA node)
+ * -precision f32 stores, ships and multiplies in float32 (half the bytes, twice the
+ * SIMD lanes); mixed ships float32 a/b but multiplies and accumulates in float64.
+ * -check uses random inputs and reports the error against a float64 product.
+ * -a/-b read the operands from binary matrix files (see mat_header_t) with collective
+ * MPI-IO: every rank reads just its slab of a and one rank per node reads b, so
+ * nothing is scattered or broadcast. -write-inputs instead writes the generated a and
+ * b to those paths. -o writes c the same way, each rank its own slab. Instead of
+ * printing c, the master reports a checksum; -verify S also recomputes S sampled
+ * entries per rank from a and b. -freivalds R runs R rounds of Freivalds' check,
+ * comparing A(Bx) with Cx for random x in O(N^2) per round, split over the ranks. */
 
-MPI_Status status;
+/* MPI datatype of an element type */
+template <typename T> static MPI_Datatype mpi_type();
+template <> MPI_Datatype mpi_type<double>() { return MPI_DOUBLE; }
+template <> MPI_Datatype mpi_type<float>() { return MPI_FLOAT; }
 
-double a[N][N], b[N][N], c[N][N];
+/* a rows x width block of a row-major matrix with leading dimension ld */
+template <typename T>
+static MPI_Datatype panel_type(int rows, int width, int ld)
+{
+    MPI_Datatype t;
+    MPI_Type_vector(rows, width, ld, mpi_type<T>(), &t);
+    MPI_Type_commit(&t);
+    return t;
+}
 
-int main(int argc, char **argv)
+/* Binary matrix file: this 64-byte header, then rows x cols entries in row-major
+ * order, in the byte order of the machine that wrote it */
+typedef struct
 {
-    int numtasks, taskid, numworkers, source, dest, rows, offset, i, j, k;
-    double t1, t2;
-    struct timeval start, stop;
-   
-    MPI_Init(&argc, &argv);
-    MPI_Comm_rank(MPI_COMM_WORLD, &taskid);
-    MPI_Comm_size(MPI_COMM_WORLD, &numtasks);
-   
-    numworkers = numtasks - 1;
-   
+    char magic[8];               /* "MATRIZ" + 2 zero bytes */
+    int64_t rows, cols;
+    int32_t elem_size;           /* 4 = float32, 8 = float64 */
+    int32_t layout;              /* 0 = row-major, the only one so far */
+    char pad[32];
+} mat_header_t;
+static_assert(sizeof(mat_header_t) == 64, "matrix file header must stay 64 bytes");
+
+static const char mat_magic[8] = { 'M', 'A', 'T', 'R', 'I', 'Z', 0, 0 };
+
+/* open an N x N matrix file on comm and read its header; aborts on a mismatch */
+static MPI_File open_matrix(MPI_Comm comm, const char *path, int N, mat_header_t *h)
+{
+    MPI_File fh;
+    if (MPI_File_open(comm, path, MPI_MODE_RDONLY, MPI_INFO_NULL, &fh) != MPI_SUCCESS)
+    {
+        fprintf(stderr, "Cannot open %s\n", path);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_File_read_at_all(fh, 0, h, sizeof(*h), MPI_BYTE, MPI_STATUS_IGNORE);
+    if (memcmp(h->magic, mat_magic, sizeof(mat_magic)) != 0 || h->layout != 0 ||
+        (h->elem_size != 4 && h->elem_size != 8) || h->rows != N || h->cols != N)
+    {
+        fprintf(stderr, "%s is not a %d x %d row-major matrix file\n", path, N, N);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    return fh;
+}
+
+/* collective read of rows [row0, row0 + nrows) into dst, converting when the file
+ * holds the other precision */
+template <typename T>
+static void read_rows(MPI_File fh, const mat_header_t *h, int row0, int nrows, int N, T *dst)
+{
+    MPI_Offset off = sizeof(mat_header_t) + (MPI_Offset)row0 * N * h->elem_size;
+    MPI_Datatype row;
+    if (h->elem_size == (int)sizeof(T))
+    {
+        MPI_Type_contiguous(N, mpi_type<T>(), &row);
+        MPI_Type_commit(&row);
+        MPI_File_read_at_all(fh, off, dst, nrows, row, MPI_STATUS_IGNORE);
+    }
+    else if (h->elem_size == 8)
+    {
+        double *tmp = mk_alloc<double>(nrows > 0 ? nrows : 1, N);
+        MPI_Type_contiguous(N, MPI_DOUBLE, &row);
+        MPI_Type_commit(&row);
+        MPI_File_read_at_all(fh, off, tmp, nrows, row, MPI_STATUS_IGNORE);
+        for (size_t e = 0; e < (size_t)nrows * N; e++)
+            dst[e] = (T)tmp[e];
+        free(tmp);
+    }
+    else
+    {
+        float *tmp = mk_alloc<float>(nrows > 0 ? nrows : 1, N);
+        MPI_Type_contiguous(N, MPI_FLOAT, &row);
+        MPI_Type_commit(&row);
+        MPI_File_read_at_all(fh, off, tmp, nrows, row, MPI_STATUS_IGNORE);
+        for (size_t e = 0; e < (size_t)nrows * N; e++)
+            dst[e] = (T)tmp[e];
+        free(tmp);
+    }
+    MPI_Type_free(&row);
+}
+
+/* collective write of an N x N matrix file: rank 0 of comm writes the header and
+ * every rank its rows [row0, row0 + nrows) */
+template <typename T>
+static void write_matrix(MPI_Comm comm, const char *path, int N, int row0, int nrows, const T *src)
+{
+    MPI_File fh;
+    MPI_Datatype row;
+    mat_header_t h;
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    if (MPI_File_open(comm, path, MPI_MODE_WRONLY | MPI_MODE_CREATE, MPI_INFO_NULL, &fh) != MPI_SUCCESS)
+    {
+        fprintf(stderr, "Cannot create %s\n", path);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_File_set_size(fh, sizeof(mat_header_t) + (MPI_Offset)N * N * sizeof(T));
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, mat_magic, sizeof(mat_magic));
+    h.rows = h.cols = N;
+    h.elem_size = sizeof(T);
+    MPI_File_write_at_all(fh, 0, &h, rank == 0 ? (int)sizeof(h) : 0, MPI_BYTE, MPI_STATUS_IGNORE);
+    MPI_Type_contiguous(N, mpi_type<T>(), &row);
+    MPI_Type_commit(&row);
+    MPI_File_write_at_all(fh, sizeof(mat_header_t) + (MPI_Offset)row0 * N * sizeof(T),
+                          src, nrows, row, MPI_STATUS_IGNORE);
+    MPI_Type_free(&row);
+    MPI_File_close(&fh);
+}
+
+/* Freivalds' check of the slab [row0, row0 + rows) of c held by this rank, with the
+ * shared helpers of matriz_kernels.h: every rank has all of b, so y = Bx is computed
+ * for the same rows and completed with one Allreduce. Returns on every rank the
+ * largest normalized residual, which the master compares with MK_FREIVALDS_TOL. */
+template <typename TI, typename TA>
+static double freivalds(int N, int rounds, uint64_t seed, int row0, int rows,
+                        const TI *a, const TI *b, const TA *c)
+{
+    size_t nx = (size_t)N * rounds;
+    double *x = (double *)malloc(sizeof(double) * (nx ? nx : 1));
+    double *y = (double *)calloc(2 * nx + 1, sizeof(double));   /* Bx, then |B||x| */
+    mk_freivalds_x(N, rounds, seed, x);
+    freivalds_bx(N, rounds, x, row0, row0 + rows, b, y);
+    MPI_Allreduce(MPI_IN_PLACE, y, (int)(2 * nx), MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    double worst = freivalds_res(N, rounds, x, y, rows, a, c);
+    MPI_Allreduce(MPI_IN_PLACE, &worst, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    free(x);
+    free(y);
+    return worst;
+}
+
+/* what every rank knows about the run, independent of the element type */
+typedef struct
+{
+    int N, panel, taskid, numtasks, numworkers;
+    const char *kernel;
+    bool check;
+    int verify;                  /* sampled entries of c recomputed per rank */
+    int freivalds;               /* rounds of Freivalds' check (0 = off) */
+    const char *afile, *bfile, *cfile;
+    bool write_inputs;           /* write the generated a/b to afile/bfile */
+    int *counts, *displs;        /* row slab of every rank */
+    MPI_Comm node_comm, leader_comm;
+    int node_rank, nnodes;
+} job_t;
+
+/* C = A*B with a, b stored and shipped as TI and c accumulated and returned as TA */
+template <typename TI, typename TA>
+static void multiply(const job_t *job, const char *precision)
+{
+    const int N = job->N, panel = job->panel, taskid = job->taskid;
+    const int rows = job->counts[taskid];
+    const int *counts = job->counts, *displs = job->displs;
+    int i, j, k, dest;
+    double t1 = 0.0, t2;
+    TI *a = NULL, *b = NULL;
+    TA *c = NULL;
+    MPI_Datatype rowtype;        /* one row of a: keeps MPI counts small for big N */
+    MPI_Type_contiguous(N, mpi_type<TI>(), &rowtype);
+    MPI_Type_commit(&rowtype);
+
+    /* b is kept once per node: the ranks of a node share an MPI_Win_allocate_shared
+     * window owned by the node leader (node rank 0; the master leads its own node),
+     * and only the leaders take part in the broadcast of b */
+    MPI_Win bwin;
+    gemm_plan_t<TI, TA> plan = gemm_plan<TI, TA>(job->kernel);
+    bool read_a = job->afile && !job->write_inputs, read_b = job->bfile && !job->write_inputs;
+    {
+        MPI_Aint bytes = job->node_rank == 0 ? (MPI_Aint)sizeof(TI) * N * N : 0;
+        int disp_unit;
+        MPI_Win_allocate_shared(bytes, sizeof(TI), MPI_INFO_NULL, job->node_comm, &b, &bwin);
+        MPI_Win_shared_query(bwin, 0, &bytes, &disp_unit, &b);
+        MPI_Win_lock_all(MPI_MODE_NOCHECK, bwin);
+        /* b is read by column micro-panels (each call packs one panel of `panel`
+         * columns), so it is first-touched in that split; the pages follow the
+         * leader's threads, which is exact with one rank per node */
+        if (job->node_rank == 0)
+            mk_first_touch_panels(b, N, N, sizeof(TI), plan.kern->nr, panel < plan.nc ? panel : plan.nc);
+    }
+
     /*---------------------------- master ----------------------------*/
     if (taskid == 0)
     {
+        a = mk_alloc<TI>(N, N);
+        c = mk_alloc<TA>(N, N);
+        if (!a || !c)
+        {
+            fprintf(stderr, "Cannot allocate a and c (%d x %d) on the master\n", N, N);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        mk_first_touch_bytes(a, N, sizeof(TI) * N);
+        mk_first_touch_bytes(c, N, sizeof(TA) * N);
+        printf("N = %d, %d ranks x %d threads on %d nodes, precision %s\n",
+               N, job->numtasks, mk_num_threads(), job->nnodes, precision);
+
         t1 = MPI_Wtime();
         for (i = 0; i < N; i++)
         {
             for (j = 0; j < N; j++)
             {
-                a[i][j] = 1.0;
-                b[i][j] = 2.0;
+                size_t e = (size_t)i * N + j;
+                if (!read_a)
+                    a[e] = job->check ? (TI)mk_rand_unit(e, 1) : (TI)1.0;
+                if (!read_b)
+                    b[e] = job->check ? (TI)mk_rand_unit(e, 2) : (TI)2.0;
+            }
+        }
+    }
+    /*---------------------------- worker ----------------------------*/
+    else
+    {
+        /* only this worker's slab of a and c; b lives in the node window */
+        a = mk_alloc<TI>(rows, N);
+        c = mk_alloc<TA>(rows, N);
+        if (!a || !c)
+        {
+            fprintf(stderr, "Worker %d: cannot allocate a and c slabs (%d x %d)\n", taskid, rows, N);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        /* place the pages on the NUMA nodes of the threads that will read them,
+         * before the incoming MPI data touches them from the main thread */
+        mk_first_touch_bytes(a, rows, sizeof(TI) * N);
+        mk_first_touch_bytes(c, rows, sizeof(TA) * N);
+    }
+
+    /* operands from files: each rank reads its slab of a (the master's is the top of its
+     * full a) and the node leaders read b, so the scatter and broadcasts below are skipped */
+    double tio = MPI_Wtime();
+    if (read_a)
+    {
+        mat_header_t h;
+        MPI_File fh = open_matrix(MPI_COMM_WORLD, job->afile, N, &h);
+        read_rows(fh, &h, displs[taskid], rows, N, a);
+        MPI_File_close(&fh);
+    }
+    if (read_b && job->leader_comm != MPI_COMM_NULL)
+    {
+        mat_header_t h;
+        MPI_File fh = open_matrix(job->leader_comm, job->bfile, N, &h);
+        read_rows(fh, &h, 0, N, N, b);
+        MPI_File_close(&fh);
+    }
+    double tread = MPI_Wtime() - tio;
+
+    /* The a slabs go out with one nonblocking scatter. b is streamed to the node leaders
+     * in column panels of width `panel`, one nonblocking broadcast each; a leader then
+     * releases panel k to the rest of its node with a nonblocking barrier (nreq[k]),
+     * after a MPI_Win_sync so the other ranks see the data. Every finished c panel goes
+     * back with MPI_Isend, so panel k is computed while k+1 and the results of k-1 are
+     * still on the wire. Panels are strided views (MPI_Type_vector) of the row-major
+     * matrices, so nothing is packed by hand. */
+    int npanels = (N + panel - 1) / panel;
+    MPI_Request *breq = (MPI_Request *)malloc(sizeof(MPI_Request) * (npanels + 1));
+    MPI_Request *nreq = (MPI_Request *)malloc(sizeof(MPI_Request) * (npanels + 1));
+    MPI_Request *creq = (MPI_Request *)malloc(sizeof(MPI_Request) * ((size_t)npanels * job->numtasks + 1));
+    int ncreq = 0;
+
+    breq[npanels] = MPI_REQUEST_NULL;
+    if (!read_a)
+        MPI_Iscatterv(a, counts, displs, rowtype,
+                      taskid == 0 ? MPI_IN_PLACE : a, rows, rowtype, 0, MPI_COMM_WORLD, &breq[npanels]);
+    for (k = 0; k < npanels; k++)
+    {
+        int w = N - k * panel < panel ? N - k * panel : panel;
+        MPI_Datatype bcol = panel_type<TI>(N, w, N);
+        breq[k] = nreq[k] = MPI_REQUEST_NULL;
+        if (job->leader_comm != MPI_COMM_NULL)
+        {
+            if (!read_b)         /* a leader that read b from the file has it already */
+                MPI_Ibcast(b + (size_t)k * panel, 1, bcol, 0, job->leader_comm, &breq[k]);
+        }
+        else
+            MPI_Ibarrier(job->node_comm, &nreq[k]);
+        MPI_Type_free(&bcol);
+    }
+    if (taskid == 0)
+    {
+        /* the master's b is complete already: release every panel to its node now */
+        MPI_Win_sync(bwin);
+        for (k = 0; k < npanels; k++)
+            MPI_Ibarrier(job->node_comm, &nreq[k]);
+    }
+
+    /* the master posts every c panel receive up front, straight into place; panels
+     * from one worker arrive in order since messages with the same tag do not overtake */
+    if (taskid == 0)
+        for (k = 0; k < npanels; k++)
+        {
+            int w = N - k * panel < panel ? N - k * panel : panel;
+            for (dest = 1; dest <= job->numworkers; dest++)
+            {
+                MPI_Datatype ccol = panel_type<TA>(counts[dest], w, N);
+                MPI_Irecv(c + (size_t)displs[dest] * N + (size_t)k * panel, 1, ccol, dest, 2,
+                          MPI_COMM_WORLD, &creq[ncreq++]);
+                MPI_Type_free(&ccol);
             }
         }
-        
-        // gettimeofday(&start, 0);
-        /* send matrix data to the worker tasks */
-        rows = N/numworkers;
-        offset = 0;
-        
-        for (dest = 1; dest <= numworkers; dest++)
+    else
+        MPI_Wait(&breq[npanels], MPI_STATUS_IGNORE);
+
+    /* Matrix multiplication: packed/blocked kernel, or the original loop. The master's
+     * a, b and c are the full matrices and its slab is their first rows; it already has
+     * every panel and just pokes the pending transfers between panels. */
+    bool naive = strcmp(job->kernel, "naive") == 0;
+    for (k = 0; k < npanels; k++)
+    {
+        int w = N - k * panel < panel ? N - k * panel : panel;
+        TI *bk = b + (size_t)k * panel;
+        TA *ck = c + (size_t)k * panel;
+
+        if (taskid > 0 && job->node_rank == 0)
+        {
+            MPI_Wait(&breq[k], MPI_STATUS_IGNORE);
+            MPI_Win_sync(bwin);
+            MPI_Ibarrier(job->node_comm, &nreq[k]);
+        }
+        else if (job->node_rank > 0)
+        {
+            MPI_Wait(&nreq[k], MPI_STATUS_IGNORE);
+            MPI_Win_sync(bwin);
+        }
+        if (naive)
+            gemm_naive(rows, w, N, a, N, bk, N, ck, N);
+        else
+            gemm_blocked(&plan, rows, w, N, a, N, bk, N, 0, ck, N);
+
+        if (taskid > 0)
         {
-            MPI_Send(&offset, 1, MPI_INT, dest, 1, MPI_COMM_WORLD);
-            MPI_Send(&rows, 1, MPI_INT, dest, 1, MPI_COMM_WORLD);
-            MPI_Send(&a[offset][0], rows * N, MPI_DOUBLE, dest, 1, MPI_COMM_WORLD);
-            MPI_Send(&b, N * N, MPI_DOUBLE, dest, 1, MPI_COMM_WORLD);
-            offset = offset + rows;
+            MPI_Datatype ccol = panel_type<TA>(rows, w, N);
+            MPI_Isend(ck, 1, ccol, 0, 2, MPI_COMM_WORLD, &creq[ncreq++]);
+            MPI_Type_free(&ccol);
         }
-        
-        /* wait for results from all worker tasks */
-        for (i = 1; i <= numworkers; i++)
+        else
         {
-            source = i;
-            MPI_Recv(&offset, 1, MPI_INT, source, 2, MPI_COMM_WORLD, &status);
-            MPI_Recv(&rows, 1, MPI_INT, source, 2, MPI_COMM_WORLD, &status);
-            MPI_Recv(&c[offset][0], rows * N, MPI_DOUBLE, source, 2, MPI_COMM_WORLD,
-                     &status);
+            int done;
+            MPI_Testall(npanels + 1, breq, &done, MPI_STATUSES_IGNORE);
+            MPI_Testall(npanels, nreq, &done, MPI_STATUSES_IGNORE);
+            MPI_Testall(ncreq, creq, &done, MPI_STATUSES_IGNORE);
         }
-       
-        // gettimeofday(&stop, 0);
+    }
+    MPI_Waitall(npanels + 1, breq, MPI_STATUSES_IGNORE);
+    MPI_Waitall(npanels, nreq, MPI_STATUSES_IGNORE);
+    MPI_Waitall(ncreq, creq, MPI_STATUSES_IGNORE);
+    free(breq);
+    free(nreq);
+    free(creq);
+
+    if (taskid == 0)
         t2 = MPI_Wtime();
-        printf("Here is the result matrix:\n");
-        for (i = 0; i < N; i++)
+
+    /* checksum of c and sampled entries recomputed from a and b, each rank over its
+     * own slab (the master's is the top of its full c), summed/maxed on the master */
+    double local[3] = { 0.0, 0.0, 0.0 }, total[3];
+    for (size_t e = 0; e < (size_t)rows * N; e++)
+    {
+        local[0] += (double)c[e];
+        local[1] += fabs((double)c[e]);
+    }
+    if (rows > 0)
+    {
+        uint64_t state = 0x9E3779B97F4A7C15ULL * (uint64_t)(taskid + 1);
+        for (int s = 0; s < job->verify; s++)
         {
-            for (j = 0; j < N; j++)
-                printf("%6.2f ", c[i][j]);
-            printf("\n");
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            i = (int)((state >> 33) % (uint64_t)rows);
+            j = (int)((state >> 11) % (uint64_t)N);
+            double ref = 0.0, mag = 0.0;
+            for (k = 0; k < N; k++)
+            {
+                double p = (double)a[(size_t)i * N + k] * (double)b[(size_t)k * N + j];
+                ref += p;
+                mag += fabs(p);
+            }
+            double err = fabs(ref - (double)c[(size_t)i * N + j]) / (mag > 0.0 ? mag : 1.0);
+            local[2] = fmax(local[2], err);
+        }
+    }
+    MPI_Reduce(local, total, 2, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&local[2], &total[2], 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+    /* x comes from a seed the master draws at run time */
+    double fres = 0.0, tfv = MPI_Wtime();
+    if (job->freivalds > 0)
+    {
+        uint64_t seed = (uint64_t)(MPI_Wtime() * 1e6);
+        MPI_Bcast(&seed, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+        fres = freivalds(N, job->freivalds, seed, displs[taskid], rows, a, b, c);
+    }
+    tfv = MPI_Wtime() - tfv;
+
+    /* files out: the generated inputs if asked, then c, every rank its own slab */
+    tio = MPI_Wtime();
+    if (job->write_inputs && job->afile)
+        write_matrix(MPI_COMM_WORLD, job->afile, N, displs[taskid], rows, a);
+    if (job->write_inputs && job->bfile)
+        write_matrix(MPI_COMM_WORLD, job->bfile, N, 0, taskid == 0 ? N : 0, b);
+    if (job->cfile)
+        write_matrix(MPI_COMM_WORLD, job->cfile, N, displs[taskid], rows, c);
+    double twrite = MPI_Wtime() - tio;
+
+    if (taskid == 0)
+    {
+        printf("Elapsed time is %f\n", t2 - t1);
+        printf("Performance: %.2f GFLOPS\n", 2.0 * N * N * N / (t2 - t1) / 1e9);
+        printf("Checksum: sum(c) = %.17g, sum|c| = %.17g\n", total[0], total[1]);
+        if (job->verify > 0)
+            printf("Sampled %d entries per rank: max relative error = %g\n", job->verify, total[2]);
+        if (job->freivalds > 0)
+        {
+            double tol = MK_FREIVALDS_TOL(N, std::numeric_limits<TA>::epsilon());
+            printf("Freivalds check (%d rounds, %f s): max relative residual = %g (tolerance %g): %s\n",
+                   job->freivalds, tfv, fres, tol, fres <= tol ? "PASSED" : "FAILED");
         }
-        
-        // fprintf(stdout,"Time = %.6f\n\n",(stop.tv_sec+stop.tv_usec*1e-6)-
-(start.tv_sec+start.tv_usec*1e-6);
-printf("Elapsed time is %f\n", t2 - t1);
-    }
-    /*---------------------------- worker----------------------------*/
-    if (taskid > 0)
-    {
-        source = 0;
-        MPI_Recv(&offset, 1, MPI_INT, source, 1, MPI_COMM_WORLD, &status);
-        MPI_Recv(&rows, 1, MPI_INT, source, 1, MPI_COMM_WORLD, &status);
-        MPI_Recv(&a, rows * N, MPI_DOUBLE, source, 1, MPI_COMM_WORLD, &status);
-        MPI_Recv(&b, N * N, MPI_DOUBLE, source, 1, MPI_COMM_WORLD, &status);
-        /* Matrix multiplication */
-        for (k = 0; k < N; k++)
-            for (i = 0; i < rows; i++)
+        if (read_a || read_b)
+            printf("Read inputs in %f s\n", tread);
+        if (job->cfile || (job->write_inputs && (job->afile || job->bfile)))
+            printf("Wrote matrix files in %f s\n", twrite);
+
+        if (job->check && (read_a || read_b))
+            printf("-check needs generated inputs; use -verify with -a/-b\n");
+        else if (job->check)
+        {
+            /* residual against a float64 product of the unrounded inputs: the
+             * original naive loop for f64, the blocked double kernel otherwise */
+            double *ad = mk_matrix_alloc(N, N), *bd = mk_matrix_alloc(N, N), *r = mk_matrix_alloc(N, N);
+            double maxdiff = 0.0, maxref = 0.0;
+            for (size_t e = 0; e < (size_t)N * N; e++)
+            {
+                ad[e] = mk_rand_unit(e, 1);
+                bd[e] = mk_rand_unit(e, 2);
+            }
+            if (sizeof(TI) == sizeof(double) && sizeof(TA) == sizeof(double))
+                dgemm_naive(N, N, N, ad, N, bd, N, r, N);
+            else
             {
-                c[i][k] = 0.0;
-                for (j = 0; j < N; j++)
-                    c[i][k] = c[i][k] + a[i][j] * b[j][k];
+                dgemm_plan_t dplan = dgemm_plan("auto", 0, 0, 0);
+                dgemm_blocked(&dplan, N, N, N, ad, N, bd, N, 0, r, N);
             }
-        MPI_Send(&offset, 1, MPI_INT, 0, 2, MPI_COMM_WORLD);
-        MPI_Send(&rows, 1, MPI_INT, 0, 2, MPI_COMM_WORLD);
-        MPI_Send(&c, rows * N, MPI_DOUBLE, 0, 2, MPI_COMM_WORLD);
+            for (size_t e = 0; e < (size_t)N * N; e++)
+            {
+                maxdiff = fmax(maxdiff, fabs(r[e] - (double)c[e]));
+                maxref = fmax(maxref, fabs(r[e]));
+            }
+            printf("Check against float64 result: max |diff| = %g, max relative error = %g\n",
+                   maxdiff, maxref > 0.0 ? maxdiff / maxref : 0.0);
+            mk_matrix_free(ad);
+            mk_matrix_free(bd);
+            mk_matrix_free(r);
+        }
     }
+    free(a);
+    free(c);
+    MPI_Win_unlock_all(bwin);
+    MPI_Win_free(&bwin);
+    MPI_Type_free(&rowtype);
+}
+
+int main(int argc, char **argv)
+{
+    job_t job;
+    int i, dest;
+    const char *precision = "f64";   /* f64 | f32 | mixed (f32 inputs, f64 accumulation) */
+
+    job.N = 2000;                /* number of rows and columns in matrix */
+    job.kernel = "auto";         /* naive | generic | avx2 | avx512 | auto */
+    job.check = false;           /* random inputs, compared with a float64 product */
+    job.panel = 512;             /* columns of b (and c) per pipelined panel */
+    job.verify = 0;
+    job.freivalds = 0;
+    job.afile = job.bfile = job.cfile = NULL;
+    job.write_inputs = false;
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            job.N = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-kernel") == 0 && i + 1 < argc)
+            job.kernel = argv[++i];
+        else if (strcmp(argv[i], "-check") == 0)
+            job.check = true;
+        else if (strcmp(argv[i], "-panel") == 0 && i + 1 < argc)
+            job.panel = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-precision") == 0 && i + 1 < argc)
+            precision = argv[++i];
+        else if (strcmp(argv[i], "-verify") == 0 && i + 1 < argc)
+            job.verify = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-freivalds") == 0 && i + 1 < argc)
+            job.freivalds = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc)
+            job.afile = argv[++i];
+        else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+            job.bfile = argv[++i];
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            job.cfile = argv[++i];
+        else if (strcmp(argv[i], "-write-inputs") == 0)
+            job.write_inputs = true;
+    }
+   
+    if (job.panel < 1)
+        job.panel = 1;
+
+    /* only the main thread calls MPI; the OpenMP threads live inside the kernel */
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    MPI_Comm_rank(MPI_COMM_WORLD, &job.taskid);
+    MPI_Comm_size(MPI_COMM_WORLD, &job.numtasks);
+    job.numworkers = job.numtasks - 1;
+
+    /* row slab of every rank, known everywhere so no offset/rows messages are needed;
+     * the master takes a share too, the first N % numtasks ranks get one extra row */
+    job.counts = (int *)malloc(sizeof(int) * job.numtasks);
+    job.displs = (int *)malloc(sizeof(int) * job.numtasks);
+    for (dest = 0; dest < job.numtasks; dest++)
+    {
+        job.counts[dest] = job.N / job.numtasks + (dest < job.N % job.numtasks ? 1 : 0);
+        job.displs[dest] = dest == 0 ? 0 : job.displs[dest - 1] + job.counts[dest - 1];
+    }
+
+    /* node-local communicator for the shared copy of b, and one leader per node */
+    job.nnodes = 0;
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, job.taskid, MPI_INFO_NULL, &job.node_comm);
+    MPI_Comm_rank(job.node_comm, &job.node_rank);
+    MPI_Comm_split(MPI_COMM_WORLD, job.node_rank == 0 ? 0 : MPI_UNDEFINED, job.taskid, &job.leader_comm);
+    if (job.leader_comm != MPI_COMM_NULL)
+        MPI_Comm_size(job.leader_comm, &job.nnodes);
+
+    if (strcmp(precision, "f32") == 0)
+        multiply<float, float>(&job, precision);
+    else if (strcmp(precision, "mixed") == 0)
+        multiply<float, double>(&job, precision);
+    else
+        multiply<double, double>(&job, "f64");
+
+    free(job.counts);
+    free(job.displs);
+    if (job.leader_comm != MPI_COMM_NULL)
+        MPI_Comm_free(&job.leader_comm);
+    MPI_Comm_free(&job.node_comm);
     MPI_Finalize();
-}
\ No newline at end of file
+}
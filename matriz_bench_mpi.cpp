@@ -0,0 +1,419 @@
+// matriz_bench_mpi.cpp
+// Benchmark de GFLOPS/roofline dos kernels de multiplicacao de matrizes (matriz_kernels.h)
+// Compile: mpicxx -O3 -march=native -fopenmp -std=c++17 -o matriz_bench_mpi matriz_bench_mpi.cpp
+// Execute: mpirun -np 4 ./matriz_bench_mpi -sizes 512,1024,2048 -threads 1,2 [-bench_out res]
+//
+// Varre (listas separadas por virgula):
+//   -sizes    ordens N
+//   -kernels  naive (laco original k,i,j), reordered (i,k,j, linha de C no cache),
+//             generic / avx2 / avx512 (dgemm_blocked com o micro-kernel pedido);
+//             kernels que a CPU nao suporta sao pulados
+//   -mc, -kc, -nc  tamanhos de bloco do dgemm_blocked (0 = padrao do dgemm_plan)
+//   -threads  threads OpenMP por rank
+//   -ranks    numero de ranks usados (padrao 1, 2, 4, ..., P); os demais ficam ociosos
+// Cada configuracao roda -reps vezes (vale a melhor) com o esquema master/worker em
+// tres fases separadas por barreiras, cronometradas a parte:
+//   distribuicao (Scatterv das fatias de A + Bcast de B), calculo, coleta (Gatherv de C).
+//
+// Roofline: para cada (ranks, threads) mede
+//   - o pico de calculo rodando o micro-kernel com os operandos no L1 (kc escolhido
+//     para Ap + Bp ocuparem metade do L1) em todas as threads de todos os ranks ao
+//     mesmo tempo, melhor de 5;
+//   - a banda de memoria com um triad no estilo STREAM (a = b + s*c, -stream_mb por
+//     vetor), tambem em todos os ranks ao mesmo tempo.
+// A intensidade aritmetica usa o trafego minimo do calculo (ler A e B, escrever C uma
+// vez em cada rank), e o teto e min(pico, intensidade * banda). A banda "atingida" e
+// esse trafego minimo / tempo de calculo, um limite inferior do trafego real.
+// Saida em CSV (stdout ou <prefixo>.csv) e JSON (<prefixo>.json com -bench_out).
+
+#include <mpi.h>
+#include <cstdint>
+#include <cstdio>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+#include "matriz_kernels.h"
+
+struct Args {
+    std::vector<int> sizes{512, 1024, 2048};
+    std::vector<std::string> kernels{"naive", "reordered", "generic", "avx2", "avx512"};
+    std::vector<int> mc{0}, kc{0}, nc{0};
+    std::vector<int> threads{0};       // 0 = OMP_NUM_THREADS
+    std::vector<int> ranks;            // vazio = 1, 2, 4, ..., P
+    int naive_max = 2048;              // naive/reordered so ate este N (sao O(N^3) lentos)
+    int reps = 3;
+    double stream_mb = 64.0;           // MB por vetor do triad
+    std::string bench_out;             // prefixo dos arquivos .csv/.json
+};
+
+static std::vector<int> parse_ints(const std::string& s) {
+    std::vector<int> v;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) if (!item.empty()) v.push_back(std::stoi(item));
+    return v;
+}
+
+static std::vector<std::string> parse_names(const std::string& s) {
+    std::vector<std::string> v;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) if (!item.empty()) v.push_back(item);
+    return v;
+}
+
+Args parse_args(int argc, char** argv) {
+    Args a;
+    for (int i = 1; i < argc; ++i) {
+        std::string s = argv[i];
+        if (s == "-sizes" && i+1<argc) a.sizes = parse_ints(argv[++i]);
+        else if (s == "-kernels" && i+1<argc) a.kernels = parse_names(argv[++i]);
+        else if (s == "-mc" && i+1<argc) a.mc = parse_ints(argv[++i]);
+        else if (s == "-kc" && i+1<argc) a.kc = parse_ints(argv[++i]);
+        else if (s == "-nc" && i+1<argc) a.nc = parse_ints(argv[++i]);
+        else if (s == "-threads" && i+1<argc) a.threads = parse_ints(argv[++i]);
+        else if (s == "-ranks" && i+1<argc) a.ranks = parse_ints(argv[++i]);
+        else if (s == "-naive_max" && i+1<argc) a.naive_max = std::stoi(argv[++i]);
+        else if (s == "-reps" && i+1<argc) a.reps = std::max(1, std::stoi(argv[++i]));
+        else if (s == "-stream_mb" && i+1<argc) a.stream_mb = std::stod(argv[++i]);
+        else if (s == "-bench_out" && i+1<argc) a.bench_out = argv[++i];
+    }
+    return a;
+}
+
+// Laco reordenado i, k, j: a linha i de C fica no cache e B e lida por linhas
+static void dgemm_reordered(int m, int n, int k, const double* A, int lda,
+                            const double* B, int ldb, double* C, int ldc) {
+    MK_OMP(omp parallel for schedule(static))
+    for (int i = 0; i < m; ++i) {
+        double* ci = C + (size_t)i * ldc;
+        for (int j = 0; j < n; ++j) ci[j] = 0.0;
+        for (int p = 0; p < k; ++p) {
+            double aip = A[(size_t)i * lda + p];
+            const double* bp = B + (size_t)p * ldb;
+            for (int j = 0; j < n; ++j) ci[j] += aip * bp[j];
+        }
+    }
+}
+
+// ---------------- Sondas do roofline ----------------
+
+// Tamanho do L1 de dados (sysconf no Linux; 32 KB se desconhecido)
+static size_t l1_bytes() {
+#if defined(__linux__) && defined(_SC_LEVEL1_DCACHE_SIZE)
+    long l1 = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+    if (l1 > 0) return (size_t) l1;
+#endif
+    return 32 * 1024;
+}
+
+// Pico de calculo: o micro-kernel com Ap, Bp e C no L1, em todas as threads do rank.
+// kc e o maior (ate 256) com Ap + Bp em metade do L1, o resto fica para C e a pilha.
+// Todos os ranks de comm rodam juntos ~0.1 s por rodada, melhor de 5 (a primeira
+// tambem acorda as threads); devolve o total de flops dividido pelo tempo do rank
+// mais lento, em GFLOPS.
+static double probe_peak(const dgemm_kernel_t* kern, MPI_Comm comm) {
+    const int kc = (int) std::min<size_t>(256, l1_bytes() / 2 / (sizeof(double) * (kern->mr + kern->nr)));
+    const double call_flops = 2.0 * kern->mr * kern->nr * kc;
+    double* Ap = (double*) mk_aligned_alloc(sizeof(double) * kc * kern->mr);
+    double* Bp = (double*) mk_aligned_alloc(sizeof(double) * kc * kern->nr);
+    for (int i = 0; i < kc * kern->mr; ++i) Ap[i] = 1e-3 * (i % 7);
+    for (int i = 0; i < kc * kern->nr; ++i) Bp[i] = 1e-3 * (i % 5);
+
+    // aquecimento, que tambem estima quantas chamadas cabem em 0.1 s
+    double C0[MK_MR_MAX * MK_NR_MAX] = {0.0};
+    double t = MPI_Wtime();
+    for (int r = 0; r < 2000; ++r) kern->ukr(kc, Ap, Bp, C0, kern->nr);
+    t = MPI_Wtime() - t;
+    long calls = std::max(2000L, (long)(0.1 / std::max(t, 1e-9) * 2000)), maxcalls;
+    MPI_Allreduce(&calls, &maxcalls, 1, MPI_LONG, MPI_MAX, comm);
+
+    int nt = 1;
+    double best = 1e30;
+    for (int rep = 0; rep < 5; ++rep) {
+        MPI_Barrier(comm);
+        t = MPI_Wtime();
+        MK_OMP(omp parallel)
+        {
+            double C[MK_MR_MAX * MK_NR_MAX] = {0.0};
+            for (long r = 0; r < maxcalls; ++r) kern->ukr(kc, Ap, Bp, C, kern->nr);
+            MK_OMP(omp master)
+            nt = mk_num_threads();
+            // evita que o compilador descarte as chamadas
+            if (C[0] == 12345.678) std::printf("%g\n", C[0]);
+        }
+        t = MPI_Wtime() - t;
+        double tmax;
+        MPI_Allreduce(&t, &tmax, 1, MPI_DOUBLE, MPI_MAX, comm);
+        best = std::min(best, tmax);
+    }
+    free(Ap);
+    free(Bp);
+    double flops = call_flops * (double) maxcalls * nt, total;
+    MPI_Allreduce(&flops, &total, 1, MPI_DOUBLE, MPI_SUM, comm);
+    return total / best / 1e9;
+}
+
+// Banda de memoria: triad a = b + s*c (24 bytes por elemento, contando so o trafego
+// util, como o STREAM), melhor de 5, em todos os ranks ao mesmo tempo. GB/s somados.
+static double probe_stream(double mb, MPI_Comm comm) {
+    size_t n = (size_t)(mb * 1e6 / sizeof(double));
+    double* a = mk_matrix_alloc(n, 1);
+    double* b = mk_matrix_alloc(n, 1);
+    double* c = mk_matrix_alloc(n, 1);
+    if (!a || !b || !c) {
+        std::fprintf(stderr, "Sem memoria para o triad (3 x %.0f MB)\n", mb);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MK_OMP(omp parallel for schedule(static))
+    for (size_t i = 0; i < n; ++i) { a[i] = 0.0; b[i] = 1.0; c[i] = 2.0; }
+    double best = 1e30;
+    for (int r = 0; r < 5; ++r) {
+        MPI_Barrier(comm);
+        double t = MPI_Wtime();
+        MK_OMP(omp parallel for schedule(static))
+        for (size_t i = 0; i < n; ++i) a[i] = b[i] + 3.0 * c[i];
+        t = MPI_Wtime() - t;
+        double tmax;
+        MPI_Allreduce(&t, &tmax, 1, MPI_DOUBLE, MPI_MAX, comm);
+        best = std::min(best, tmax);
+    }
+    if (a[n / 2] != 7.0) std::fprintf(stderr, "triad: resultado inesperado\n");
+    mk_matrix_free(a); mk_matrix_free(b); mk_matrix_free(c);
+    int p;
+    MPI_Comm_size(comm, &p);
+    return 24.0 * (double) n * p / best / 1e9;
+}
+
+// ---------------- Multiplicacao cronometrada ----------------
+
+struct Phases {
+    double dist = 0.0, comp = 0.0, gather = 0.0, err = 0.0;
+};
+
+// Uma multiplicacao master/worker sobre comm com as fases separadas por barreiras.
+// A, B, C sao N x N no rank 0; nos demais, A e C sao a fatia e B e inteira.
+static Phases run_once(const std::string& kernel, const dgemm_plan_t& plan, int N,
+                       double* A, double* B, double* C,
+                       const std::vector<int>& counts, const std::vector<int>& displs, MPI_Comm comm) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Datatype row;
+    MPI_Type_contiguous(N, MPI_DOUBLE, &row);
+    MPI_Type_commit(&row);
+    const int rows = counts[rank];
+    Phases ph;
+
+    MPI_Barrier(comm);
+    double t0 = MPI_Wtime();
+    MPI_Scatterv(A, counts.data(), displs.data(), row,
+                 rank == 0 ? MPI_IN_PLACE : A, rows, row, 0, comm);
+    MPI_Bcast(B, N, row, 0, comm);
+    MPI_Barrier(comm);
+    double t1 = MPI_Wtime();
+
+    if (kernel == "naive")
+        dgemm_naive(rows, N, N, A, N, B, N, C, N);
+    else if (kernel == "reordered")
+        dgemm_reordered(rows, N, N, A, N, B, N, C, N);
+    else
+        dgemm_blocked(&plan, rows, N, N, A, N, B, N, 0, C, N);
+    MPI_Barrier(comm);
+    double t2 = MPI_Wtime();
+
+    MPI_Gatherv(rank == 0 ? MPI_IN_PLACE : C, rows, row,
+                C, counts.data(), displs.data(), row, 0, comm);
+    MPI_Barrier(comm);
+    double t3 = MPI_Wtime();
+
+    ph.dist = t1 - t0;
+    ph.comp = t2 - t1;
+    ph.gather = t3 - t2;
+    // confere 8 entradas de C no master (uma por fatia, ciclicamente)
+    if (rank == 0) {
+        for (int s = 0; s < 8; ++s) {
+            int i = (int)((uint64_t) s * 2654435761ULL % (uint64_t) N), j = (s * 977) % N;
+            double ref = 0.0, mag = 0.0;
+            for (int k = 0; k < N; ++k) {
+                double p = mk_rand_unit((uint64_t) i * N + k, 1) * mk_rand_unit((uint64_t) k * N + j, 2);
+                ref += p;
+                mag += std::fabs(p);
+            }
+            ph.err = std::max(ph.err, std::fabs(ref - C[(size_t) i * N + j]) / mag);
+        }
+    }
+    MPI_Type_free(&row);
+    return ph;
+}
+
+struct BenchRow {
+    std::string kernel;
+    int n, ranks, threads, mc, kc, nc;
+    Phases t;
+    double peak, stream;
+};
+
+int main(int argc, char** argv) {
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    int rank = 0, size = 1;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    Args args = parse_args(argc, argv);
+
+    std::vector<int> rank_counts = args.ranks;
+    if (rank_counts.empty()) {
+        for (int p = 1; p <= size; p *= 2) rank_counts.push_back(p);
+        if (rank_counts.back() != size) rank_counts.push_back(size);
+    }
+    std::vector<std::string> kernels;
+    for (const std::string& k : args.kernels)
+        if (k == "naive" || k == "reordered" || mk_isa_supported(k.c_str())) kernels.push_back(k);
+        else if (rank == 0) std::fprintf(stderr, "Kernel %s nao suportado nesta CPU, pulado\n", k.c_str());
+    const dgemm_kernel_t* best = dgemm_select_kernel("auto");
+
+    std::vector<BenchRow> rows;
+    for (int p : rank_counts) {
+        if (p < 1 || p > size) continue;
+        MPI_Comm comm;
+        MPI_Comm_split(MPI_COMM_WORLD, rank < p ? 0 : MPI_UNDEFINED, rank, &comm);
+        for (int th : args.threads) {
+#ifdef _OPENMP
+            if (th > 0) omp_set_num_threads(th);
+#else
+            (void) th;
+#endif
+            if (comm == MPI_COMM_NULL) continue;
+            int nt = mk_num_threads();
+            // pico do melhor micro-kernel e banda, medidos com estes ranks/threads
+            double peak = probe_peak(best, comm);
+            double stream = probe_stream(args.stream_mb, comm);
+
+            for (int N : args.sizes) {
+                std::vector<int> counts(p), displs(p);
+                for (int r = 0; r < p; ++r) {
+                    counts[r] = N / p + (r < N % p ? 1 : 0);
+                    displs[r] = r == 0 ? 0 : displs[r-1] + counts[r-1];
+                }
+                int mrows = rank == 0 ? N : counts[rank];
+                double* A = mk_matrix_alloc(mrows, N);
+                double* B = mk_matrix_alloc(N, N);
+                double* C = mk_matrix_alloc(mrows, N);
+                if (!A || !B || !C) {
+                    std::fprintf(stderr, "Rank %d: sem memoria para N = %d\n", rank, N);
+                    MPI_Abort(MPI_COMM_WORLD, 1);
+                }
+                mk_first_touch(A, mrows, N);
+                // B na divisao de paineis do plano padrao (a varredura de nc muda isso)
+                mk_first_touch_panels(B, N, N, sizeof(double), best->nr, dgemm_plan("auto", 0, 0, 0).nc);
+                mk_first_touch(C, mrows, N);
+                if (rank == 0)
+                    for (size_t e = 0; e < (size_t) N * N; ++e) {
+                        A[e] = mk_rand_unit(e, 1);
+                        B[e] = mk_rand_unit(e, 2);
+                    }
+
+                for (const std::string& k : kernels) {
+                    bool blocked = k != "naive" && k != "reordered";
+                    if (!blocked && N > args.naive_max) continue;
+                    for (int mc : blocked ? args.mc : std::vector<int>{0})
+                    for (int kc : blocked ? args.kc : std::vector<int>{0})
+                    for (int nc : blocked ? args.nc : std::vector<int>{0}) {
+                        dgemm_plan_t plan = dgemm_plan(blocked ? k.c_str() : "generic", mc, kc, nc);
+                        Phases bestp;
+                        double bestt = 1e30;
+                        for (int r = 0; r < args.reps; ++r) {
+                            Phases ph = run_once(k, plan, N, A, B, C, counts, displs, comm);
+                            if (ph.dist + ph.comp + ph.gather < bestt) {
+                                bestt = ph.dist + ph.comp + ph.gather;
+                                bestp = ph;
+                            }
+                        }
+                        BenchRow row;
+                        row.kernel = k;
+                        row.n = N;
+                        row.ranks = p;
+                        row.threads = nt;
+                        row.mc = blocked ? plan.mc : 0;
+                        row.kc = blocked ? plan.kc : 0;
+                        row.nc = blocked ? plan.nc : 0;
+                        row.t = bestp;
+                        row.peak = peak;
+                        row.stream = stream;
+                        rows.push_back(row);
+                    }
+                }
+                mk_matrix_free(A);
+                mk_matrix_free(B);
+                mk_matrix_free(C);
+            }
+        }
+        if (comm != MPI_COMM_NULL) MPI_Comm_free(&comm);
+    }
+
+    if (rank != 0) {
+        MPI_Finalize();
+        return 0;
+    }
+
+    std::ostringstream csv, json;
+    csv << "kernel,n,ranks,threads,mc,kc,nc,dist_s,compute_s,gather_s,total_s,"
+           "gflops_compute,gflops_total,dist_gbs,gather_gbs,compute_min_gbs,"
+           "peak_gflops,stream_gbs,intensity_flop_per_byte,roofline_gflops,roofline_frac,max_rel_err\n";
+    json << "[\n";
+    for (size_t i = 0; i < rows.size(); ++i) {
+        const BenchRow& r = rows[i];
+        double n = r.n, flops = 2.0 * n * n * n;
+        double total = r.t.dist + r.t.comp + r.t.gather;
+        // bytes na rede: fatias de A fora do master + B para cada worker; C de volta
+        double dist_bytes = 8.0 * (n * n * (r.ranks - 1) / r.ranks + n * n * (r.ranks - 1));
+        double gather_bytes = 8.0 * n * n * (r.ranks - 1) / r.ranks;
+        // trafego minimo do calculo: cada rank le sua fatia de A e B inteira, escreve C
+        double comp_bytes = 8.0 * (2.0 * n * n + n * n * r.ranks);
+        double intensity = flops / comp_bytes;
+        double roof = std::min(r.peak, intensity * r.stream);
+        double gf = flops / r.t.comp / 1e9;
+        csv << r.kernel << "," << r.n << "," << r.ranks << "," << r.threads << ","
+            << r.mc << "," << r.kc << "," << r.nc << ","
+            << r.t.dist << "," << r.t.comp << "," << r.t.gather << "," << total << ","
+            << gf << "," << flops / total / 1e9 << ","
+            << dist_bytes / r.t.dist / 1e9 << "," << gather_bytes / r.t.gather / 1e9 << ","
+            << comp_bytes / r.t.comp / 1e9 << ","
+            << r.peak << "," << r.stream << "," << intensity << "," << roof << ","
+            << gf / roof << "," << r.t.err << "\n";
+        json << "  {\"kernel\": \"" << r.kernel << "\", \"n\": " << r.n
+             << ", \"ranks\": " << r.ranks << ", \"threads\": " << r.threads
+             << ", \"mc\": " << r.mc << ", \"kc\": " << r.kc << ", \"nc\": " << r.nc
+             << ", \"dist_s\": " << r.t.dist << ", \"compute_s\": " << r.t.comp
+             << ", \"gather_s\": " << r.t.gather << ", \"total_s\": " << total
+             << ", \"gflops_compute\": " << gf << ", \"gflops_total\": " << flops / total / 1e9
+             << ", \"dist_gbs\": " << dist_bytes / r.t.dist / 1e9
+             << ", \"gather_gbs\": " << gather_bytes / r.t.gather / 1e9
+             << ", \"compute_min_gbs\": " << comp_bytes / r.t.comp / 1e9
+             << ", \"peak_gflops\": " << r.peak << ", \"stream_gbs\": " << r.stream
+             << ", \"intensity_flop_per_byte\": " << intensity
+             << ", \"roofline_gflops\": " << roof << ", \"roofline_frac\": " << gf / roof
+             << ", \"max_rel_err\": " << r.t.err << "}"
+             << (i + 1 < rows.size() ? "," : "") << "\n";
+    }
+    json << "]\n";
+
+    if (args.bench_out.empty()) {
+        std::cout << csv.str();
+    } else {
+        std::ofstream(args.bench_out + ".csv") << csv.str();
+        std::ofstream(args.bench_out + ".json") << json.str();
+        std::cout << "Benchmark gravado em " << args.bench_out << ".csv e "
+                  << args.bench_out << ".json (" << rows.size() << " linhas)\n";
+    }
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,548 @@
+// matriz_esparsa_mpi.cpp
+// Multiplicacao distribuida de matrizes esparsas em CSR ou ELL:
+//   -op spmm  : C = A * B, A esparsa N x N, B densa N x K   (SpMM)
+//   -op spgemm: C = A * B, A e B esparsas N x N, C em CSR  (SpGEMM, Gustavson)
+// Compile: mpicxx -O3 -march=native -fopenmp -std=c++17 -o matriz_esparsa_mpi matriz_esparsa_mpi.cpp
+// Execute: mpirun -np 8 ./matriz_esparsa_mpi -n 1000000 -nnz 16 [-op spgemm] [-band 5000]
+//                                            [-format ell] [-check]
+//
+// - Linhas de A (e de B) sao divididas por numero de nao-zeros, nao por N/P: cada
+//   rank recebe ~nnz(A)/P, o que importa quando a densidade varia por linha (-skew).
+// - As matrizes sao geradas por hash do indice global, entao cada rank monta so as
+//   suas linhas. A e gerada primeiro em N/P linhas por rank; os nnz reais (com o
+//   corte da banda e sem colunas repetidas) dao os cortes por um MPI_Exscan e as
+//   linhas migram para o dono final com MPI_Alltoallv.
+// - Cada rank pede aos donos apenas as linhas de B cujas colunas aparecem nas suas
+//   linhas de A (MPI_Alltoallv de indices e depois das linhas), em vez de B inteira.
+// - -format ell (so spmm): A local vai para ELL em fatias de ELL_C linhas (SELL-C-sigma),
+//   cada fatia com a largura da sua linha mais longa, depois de ordenar as linhas por
+//   tamanho dentro de janelas de ELL_SIGMA linhas. O laco interno nao tem ptr[i]
+//   variavel e le ELL_C linhas em passo unitario; fatias e ordenacao limitam o
+//   preenchimento com -skew, onde o ELL puro teria todas as linhas com o tamanho da
+//   mais densa. O SpGEMM fica em CSR (as linhas de C tem tamanho desconhecido ate o
+//   passo simbolico).
+// Memoria e tempo escalam com nnz, nao com N^2.
+
+#include <mpi.h>
+#include <cstdint>
+#include <cstdio>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "matriz_kernels.h"
+
+struct Args {
+    int64_t n = 100000;          // ordem de A (e linhas de B)
+    double nnz = 16;             // media de nao-zeros por linha
+    double skew = 0.5;           // 0 = linhas uniformes; -> 1 = poucas linhas muito densas
+    int64_t band = 0;            // colunas em |j - i| <= band (0 = espalhadas em toda a linha)
+    std::string op = "spmm";     // spmm | spgemm
+    std::string format = "csr";  // csr | ell (formato de A no spmm)
+    int k = 16;                  // colunas de B densa no spmm
+    bool rows_split = false;     // -rows: divide por linhas (N/P), para comparar
+    bool check = false;          // confere C*x contra A*(B*x)
+};
+
+Args parse_args(int argc, char** argv) {
+    Args a;
+    for (int i = 1; i < argc; ++i) {
+        std::string s = argv[i];
+        if (s == "-n" && i+1<argc) a.n = std::stoll(argv[++i]);
+        else if (s == "-nnz" && i+1<argc) a.nnz = std::stod(argv[++i]);
+        else if (s == "-skew" && i+1<argc) a.skew = std::min(0.95, std::max(0.0, std::stod(argv[++i])));
+        else if (s == "-band" && i+1<argc) a.band = std::stoll(argv[++i]);
+        else if (s == "-op" && i+1<argc) a.op = argv[++i];
+        else if (s == "-format" && i+1<argc) a.format = argv[++i];
+        else if (s == "-k" && i+1<argc) a.k = std::max(1, std::stoi(argv[++i]));
+        else if (s == "-rows") a.rows_split = true;
+        else if (s == "-check") a.check = true;
+    }
+    return a;
+}
+
+// ---------------- Geracao por hash ----------------
+
+static inline uint64_t mix64(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+static inline double unit(uint64_t h) { return (double)(h >> 11) * 0x1.0p-53; }        // [0, 1)
+static inline double value(uint64_t h) { return 2.0 * unit(h) - 1.0; }                   // [-1, 1)
+
+// nnz nominal da linha i: Pareto com media ~nnz (u^-skew tem media 1/(1-skew))
+static int64_t row_nnz(const Args& a, uint64_t seed, int64_t i) {
+    double u = std::max(unit(mix64((uint64_t)i * 0x9E3779B97F4A7C15ULL + seed)), 1e-12);
+    double r = a.nnz * (1.0 - a.skew) * std::pow(u, -a.skew);
+    return std::min<int64_t>(a.n, std::max<int64_t>(1, std::llround(r)));
+}
+
+// Colunas (ordenadas, sem repeticao) e valores da linha i
+static void gen_row(const Args& a, uint64_t seed, int64_t i,
+                    std::vector<int64_t>& cols, std::vector<double>& vals) {
+    int64_t m = row_nnz(a, seed, i);
+    size_t first = cols.size();
+    for (int64_t t = 0; t < m; ++t) {
+        uint64_t h = mix64(mix64((uint64_t)i + seed) + (uint64_t)t);
+        int64_t j;
+        if (a.band > 0) j = i - a.band + (int64_t)(h % (uint64_t)(2 * a.band + 1));
+        else j = (int64_t)(h % (uint64_t)a.n);
+        cols.push_back(((j % a.n) + a.n) % a.n);
+    }
+    std::sort(cols.begin() + first, cols.end());
+    cols.erase(std::unique(cols.begin() + first, cols.end()), cols.end());
+    for (size_t t = first; t < cols.size(); ++t)
+        vals.push_back(value(mix64((uint64_t)i * 1315423911ULL + (uint64_t)cols[t] + seed)));
+}
+
+// ---------------- CSR local ----------------
+
+struct CSR {
+    int64_t nrows = 0;
+    std::vector<int64_t> ptr{0};
+    std::vector<int64_t> col;
+    std::vector<double> val;
+};
+
+static CSR build_rows(const Args& a, uint64_t seed, int64_t lo, int64_t hi) {
+    CSR m;
+    m.nrows = hi - lo;
+    m.ptr.reserve(m.nrows + 1);
+    for (int64_t i = lo; i < hi; ++i) {
+        gen_row(a, seed, i, m.col, m.val);
+        m.ptr.push_back((int64_t) m.col.size());
+    }
+    return m;
+}
+
+// Limites [bounds[r], bounds[r+1]) com N/P linhas por rank
+static std::vector<int64_t> rows_even(int64_t n, int size) {
+    std::vector<int64_t> bounds(size + 1, n);
+    bounds[0] = 0;
+    for (int r = 1; r < size; ++r) bounds[r] = n / size * r + std::min<int64_t>(r, n % size);
+    return bounds;
+}
+
+// Divisao por nnz: cada rank fica com ~total/P nao-zeros. prov sao as linhas
+// [plo, plo + prov.nrows) ja geradas por este rank na divisao N/P; o corte r e a
+// primeira linha em que o prefixo global chega a total*r/P, e so o rank cujo
+// trecho contem esse ponto o encontra.
+static std::vector<int64_t> partition_rows(const Args& a, const CSR& prov, int64_t plo,
+                                           int size, MPI_Comm comm) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    int64_t mine = prov.ptr.back(), before = 0, total = 0;
+    MPI_Exscan(&mine, &before, 1, MPI_INT64_T, MPI_SUM, comm);
+    if (rank == 0) before = 0;   // indefinido no rank 0
+    MPI_Allreduce(&mine, &total, 1, MPI_INT64_T, MPI_SUM, comm);
+
+    std::vector<int64_t> cut(size + 1, 0), bounds(size + 1, a.n);
+    for (int r = 1; r < size; ++r) {
+        int64_t need = total * r;   // prefixo * size >= total * r
+        if (before * size >= need || (before + mine) * size < need) continue;
+        auto k = std::lower_bound(prov.ptr.begin() + 1, prov.ptr.end(), need,
+                                  [&](int64_t p, int64_t v) { return (before + p) * size < v; });
+        cut[r] = plo + (k - prov.ptr.begin());
+    }
+    MPI_Allreduce(cut.data(), bounds.data(), size, MPI_INT64_T, MPI_MAX, comm);
+    return bounds;
+}
+
+static int owner_of(const std::vector<int64_t>& bounds, int64_t j) {
+    return (int)(std::upper_bound(bounds.begin(), bounds.end(), j) - bounds.begin()) - 1;
+}
+
+// ---------------- Troca das linhas de B ----------------
+
+// Linhas remotas que este rank precisa: colunas distintas de A fora de [lo, hi),
+// ja ordenadas e portanto agrupadas por dono
+struct Halo {
+    std::vector<int64_t> rows;              // indices globais pedidos
+    std::vector<int> send_counts, send_displs;   // pedidos por dono
+    std::vector<int> recv_counts, recv_displs;   // pedidos recebidos de cada rank
+    std::vector<int64_t> requested;         // linhas locais que outros pediram
+};
+
+// Manda os pedidos de h.rows (crescentes) aos donos segundo bounds
+static void exchange_requests(Halo& h, const std::vector<int64_t>& bounds, int size, MPI_Comm comm) {
+    h.send_counts.assign(size, 0);
+    for (int64_t j : h.rows) h.send_counts[owner_of(bounds, j)]++;
+    h.recv_counts.assign(size, 0);
+    MPI_Alltoall(h.send_counts.data(), 1, MPI_INT, h.recv_counts.data(), 1, MPI_INT, comm);
+    h.send_displs.assign(size, 0);
+    h.recv_displs.assign(size, 0);
+    for (int r = 1; r < size; ++r) {
+        h.send_displs[r] = h.send_displs[r-1] + h.send_counts[r-1];
+        h.recv_displs[r] = h.recv_displs[r-1] + h.recv_counts[r-1];
+    }
+    h.requested.resize(h.recv_displs[size-1] + h.recv_counts[size-1]);
+    MPI_Alltoallv(h.rows.data(), h.send_counts.data(), h.send_displs.data(), MPI_INT64_T,
+                  h.requested.data(), h.recv_counts.data(), h.recv_displs.data(), MPI_INT64_T, comm);
+}
+
+static Halo plan_halo(const CSR& A, int64_t lo, int64_t hi, const std::vector<int64_t>& bounds,
+                      int size, MPI_Comm comm) {
+    Halo h;
+    for (int64_t j : A.col)
+        if (j < lo || j >= hi) h.rows.push_back(j);
+    std::sort(h.rows.begin(), h.rows.end());
+    h.rows.erase(std::unique(h.rows.begin(), h.rows.end()), h.rows.end());
+    exchange_requests(h, bounds, size, comm);
+    return h;
+}
+
+// Linhas densas de largura w: local e a matriz rows x w deste rank (linhas lo..hi-1);
+// devolve as linhas remotas pedidas, na ordem de h.rows
+static std::vector<double> fetch_dense(const Halo& h, const std::vector<double>& local, int w,
+                                       int64_t lo, int size, MPI_Comm comm) {
+    std::vector<double> out(h.requested.size() * (size_t) w), in(h.rows.size() * (size_t) w);
+    for (size_t t = 0; t < h.requested.size(); ++t)
+        std::copy_n(local.begin() + (h.requested[t] - lo) * w, w, out.begin() + t * w);
+    std::vector<int> sc(size), sd(size), rc(size), rd(size);
+    for (int r = 0; r < size; ++r) {
+        sc[r] = h.recv_counts[r] * w; sd[r] = h.recv_displs[r] * w;
+        rc[r] = h.send_counts[r] * w; rd[r] = h.send_displs[r] * w;
+    }
+    MPI_Alltoallv(out.data(), sc.data(), sd.data(), MPI_DOUBLE,
+                  in.data(), rc.data(), rd.data(), MPI_DOUBLE, comm);
+    return in;
+}
+
+// Linhas CSR: primeiro os tamanhos, depois colunas e valores
+static CSR fetch_csr(const Halo& h, const CSR& local, int64_t lo, int size, MPI_Comm comm) {
+    std::vector<int64_t> len_out(h.requested.size()), len_in(h.rows.size());
+    for (size_t t = 0; t < h.requested.size(); ++t) {
+        int64_t r = h.requested[t] - lo;
+        len_out[t] = local.ptr[r+1] - local.ptr[r];
+    }
+    MPI_Alltoallv(len_out.data(), h.recv_counts.data(), h.recv_displs.data(), MPI_INT64_T,
+                  len_in.data(), h.send_counts.data(), h.send_displs.data(), MPI_INT64_T, comm);
+
+    std::vector<int> sc(size, 0), sd(size, 0), rc(size, 0), rd(size, 0);
+    std::vector<int64_t> col_out;
+    std::vector<double> val_out;
+    for (int r = 0; r < size; ++r)
+        for (int t = h.recv_displs[r]; t < h.recv_displs[r] + h.recv_counts[r]; ++t) {
+            int64_t row = h.requested[t] - lo;
+            col_out.insert(col_out.end(), local.col.begin() + local.ptr[row], local.col.begin() + local.ptr[row+1]);
+            val_out.insert(val_out.end(), local.val.begin() + local.ptr[row], local.val.begin() + local.ptr[row+1]);
+            sc[r] += (int) len_out[t];
+        }
+    CSR in;
+    in.nrows = (int64_t) h.rows.size();
+    for (int r = 0; r < size; ++r)
+        for (int t = h.send_displs[r]; t < h.send_displs[r] + h.send_counts[r]; ++t) {
+            rc[r] += (int) len_in[t];
+            in.ptr.push_back(in.ptr.back() + len_in[t]);
+        }
+    for (int r = 1; r < size; ++r) { sd[r] = sd[r-1] + sc[r-1]; rd[r] = rd[r-1] + rc[r-1]; }
+    in.col.resize(in.ptr.back());
+    in.val.resize(in.ptr.back());
+    MPI_Alltoallv(col_out.data(), sc.data(), sd.data(), MPI_INT64_T,
+                  in.col.data(), rc.data(), rd.data(), MPI_INT64_T, comm);
+    MPI_Alltoallv(val_out.data(), sc.data(), sd.data(), MPI_DOUBLE,
+                  in.val.data(), rc.data(), rd.data(), MPI_DOUBLE, comm);
+    return in;
+}
+
+// Linhas [lo, hi) vindas de quem as gerou na divisao prov (prov_lo e o inicio local)
+static CSR move_rows(const CSR& prov, int64_t prov_lo, const std::vector<int64_t>& prov_bounds,
+                     int64_t lo, int64_t hi, int size, MPI_Comm comm) {
+    Halo h;
+    h.rows.resize(hi - lo);
+    for (int64_t i = lo; i < hi; ++i) h.rows[i - lo] = i;
+    exchange_requests(h, prov_bounds, size, comm);
+    return fetch_csr(h, prov, prov_lo, size, comm);
+}
+
+// Coluna global de A -> indice compacto: [0, nloc) linhas locais de B, nloc + t
+// a t-esima linha remota de h.rows
+static std::vector<int64_t> compact_columns(const CSR& A, const Halo& h, int64_t lo, int64_t hi) {
+    std::vector<int64_t> idx(A.col.size());
+    for (size_t t = 0; t < A.col.size(); ++t) {
+        int64_t j = A.col[t];
+        idx[t] = (j >= lo && j < hi) ? j - lo
+               : (hi - lo) + (std::lower_bound(h.rows.begin(), h.rows.end(), j) - h.rows.begin());
+    }
+    return idx;
+}
+
+// ---------------- Kernels locais ----------------
+
+// C (rows x k) = A * [B_local; B_remote], colunas de A ja compactadas
+static void spmm(const CSR& A, const std::vector<int64_t>& cidx, const double* Bl, const double* Br,
+                 int64_t nloc, int k, double* C) {
+    MK_OMP(omp parallel for schedule(dynamic, 64))
+    for (int64_t i = 0; i < A.nrows; ++i) {
+        double* c = C + i * k;
+        std::fill(c, c + k, 0.0);
+        for (int64_t t = A.ptr[i]; t < A.ptr[i+1]; ++t) {
+            int64_t j = cidx[t];
+            const double* b = j < nloc ? Bl + j * k : Br + (j - nloc) * k;
+            double v = A.val[t];
+            for (int q = 0; q < k; ++q) c[q] += v * b[q];
+        }
+    }
+}
+
+// ---------------- ELL em fatias ----------------
+
+// linhas por fatia (um registrador AVX-512 de doubles) e janela da ordenacao por
+// tamanho (multiplo de ELL_C; as linhas so mudam de lugar dentro da janela)
+static const int ELL_C = 8, ELL_SIGMA = 256;
+
+// Fatia s cobre as linhas ordenadas [s*ELL_C, s*ELL_C + ELL_C); a linha ordenada p e a
+// linha perm[p] de A e de C, e sua entrada t fica em base[s] + t * ELL_C + p % ELL_C.
+// Posicoes de preenchimento tem valor 0 e coluna 0 (compacta), entao o laco nao
+// testa o fim de cada linha.
+struct ELL {
+    int64_t nrows = 0;
+    std::vector<int64_t> perm;
+    std::vector<int64_t> base{0};
+    std::vector<int64_t> col;
+    std::vector<double> val;
+};
+
+// A (CSR) -> ELL em fatias, ja com as colunas compactadas de cidx
+static ELL to_ell(const CSR& A, const std::vector<int64_t>& cidx) {
+    ELL e;
+    e.nrows = A.nrows;
+    auto len = [&](int64_t i) { return A.ptr[i+1] - A.ptr[i]; };
+    e.perm.resize(A.nrows);
+    for (int64_t i = 0; i < A.nrows; ++i) e.perm[i] = i;
+    for (int64_t w0 = 0; w0 < A.nrows; w0 += ELL_SIGMA)
+        std::stable_sort(e.perm.begin() + w0, e.perm.begin() + std::min(A.nrows, w0 + ELL_SIGMA),
+                         [&](int64_t x, int64_t y) { return len(x) > len(y); });
+    int64_t nslices = (A.nrows + ELL_C - 1) / ELL_C;
+    e.base.resize(nslices + 1);
+    for (int64_t s = 0; s < nslices; ++s) {
+        int64_t w = 0;
+        for (int64_t p = s * ELL_C; p < std::min(A.nrows, (s + 1) * ELL_C); ++p)
+            w = std::max(w, len(e.perm[p]));
+        e.base[s+1] = e.base[s] + w * ELL_C;
+    }
+    e.col.assign(e.base.back(), 0);
+    e.val.assign(e.base.back(), 0.0);
+    MK_OMP(omp parallel for schedule(static))
+    for (int64_t s = 0; s < nslices; ++s)
+        for (int64_t p = s * ELL_C; p < std::min(A.nrows, (s + 1) * ELL_C); ++p) {
+            int64_t i = e.perm[p];
+            int r = (int)(p - s * ELL_C);
+            for (int64_t t = A.ptr[i]; t < A.ptr[i+1]; ++t) {
+                size_t pos = (size_t)(e.base[s] + (t - A.ptr[i]) * ELL_C + r);
+                e.col[pos] = cidx[t];
+                e.val[pos] = A.val[t];
+            }
+        }
+    return e;
+}
+
+// C (rows x k) = A * [B_local; B_remote] com A em ELL; por fatia, cada passo t soma
+// uma entrada de cada uma das ELL_C linhas
+static void spmm_ell(const ELL& A, const double* Bl, const double* Br, int64_t nloc, int k, double* C) {
+    int64_t nslices = (int64_t) A.base.size() - 1;
+    MK_OMP(omp parallel for schedule(dynamic, 8))
+    for (int64_t s = 0; s < nslices; ++s) {
+        int64_t r0 = s * ELL_C;
+        int rows = (int) std::min<int64_t>(ELL_C, A.nrows - r0);
+        int64_t w = (A.base[s+1] - A.base[s]) / ELL_C;
+        for (int r = 0; r < rows; ++r) std::fill(C + A.perm[r0 + r] * k, C + (A.perm[r0 + r] + 1) * k, 0.0);
+        const int64_t* cs = A.col.data() + A.base[s];
+        const double* vs = A.val.data() + A.base[s];
+        for (int64_t t = 0; t < w; ++t)
+            for (int r = 0; r < rows; ++r) {
+                int64_t j = cs[t * ELL_C + r];
+                const double* b = j < nloc ? Bl + j * k : Br + (j - nloc) * k;
+                double v = vs[t * ELL_C + r];
+                double* c = C + A.perm[r0 + r] * k;
+                for (int q = 0; q < k; ++q) c[q] += v * b[q];
+            }
+    }
+}
+
+// C = A * B por Gustavson: acumulador denso de N posicoes por thread (SPA); primeiro
+// conta o nnz de cada linha (simbolico), depois preenche (numerico)
+static CSR spgemm(const CSR& A, const std::vector<int64_t>& cidx, const CSR& Bl, const CSR& Br,
+                  int64_t nloc, int64_t ncols) {
+    CSR C;
+    C.nrows = A.nrows;
+    C.ptr.assign(A.nrows + 1, 0);
+    auto brow = [&](int64_t j, const int64_t*& cb, const double*& vb, int64_t& len) {
+        const CSR& B = j < nloc ? Bl : Br;
+        int64_t r = j < nloc ? j : j - nloc;
+        cb = B.col.data() + B.ptr[r]; vb = B.val.data() + B.ptr[r]; len = B.ptr[r+1] - B.ptr[r];
+    };
+
+    MK_OMP(omp parallel)
+    {
+        std::vector<int64_t> mark(ncols, -1);
+        MK_OMP(omp for schedule(dynamic, 64))
+        for (int64_t i = 0; i < A.nrows; ++i) {
+            int64_t cnt = 0;
+            for (int64_t t = A.ptr[i]; t < A.ptr[i+1]; ++t) {
+                const int64_t* cb; const double* vb; int64_t len;
+                brow(cidx[t], cb, vb, len);
+                for (int64_t q = 0; q < len; ++q)
+                    if (mark[cb[q]] != i) { mark[cb[q]] = i; ++cnt; }
+            }
+            C.ptr[i+1] = cnt;
+        }
+    }
+    for (int64_t i = 0; i < A.nrows; ++i) C.ptr[i+1] += C.ptr[i];
+    C.col.resize(C.ptr.back());
+    C.val.resize(C.ptr.back());
+
+    MK_OMP(omp parallel)
+    {
+        std::vector<int64_t> mark(ncols, -1);
+        std::vector<double> acc(ncols);
+        MK_OMP(omp for schedule(dynamic, 64))
+        for (int64_t i = 0; i < A.nrows; ++i) {
+            int64_t* cc = C.col.data() + C.ptr[i];
+            int64_t n = 0;
+            for (int64_t t = A.ptr[i]; t < A.ptr[i+1]; ++t) {
+                const int64_t* cb; const double* vb; int64_t len;
+                brow(cidx[t], cb, vb, len);
+                double v = A.val[t];
+                for (int64_t q = 0; q < len; ++q) {
+                    int64_t j = cb[q];
+                    if (mark[j] != i) { mark[j] = i; cc[n++] = j; acc[j] = 0.0; }
+                    acc[j] += v * vb[q];
+                }
+            }
+            // colunas em ordem crescente dentro da linha
+            std::sort(cc, cc + n);
+            for (int64_t q = 0; q < n; ++q) C.val[C.ptr[i] + q] = acc[cc[q]];
+        }
+    }
+    return C;
+}
+
+// y = M * x para CSR com colunas globais e x dado por hash (sem comunicacao)
+static std::vector<double> csr_times_hashed(const CSR& M, uint64_t seed) {
+    std::vector<double> y(M.nrows, 0.0);
+    for (int64_t i = 0; i < M.nrows; ++i)
+        for (int64_t t = M.ptr[i]; t < M.ptr[i+1]; ++t)
+            y[i] += M.val[t] * value(mix64((uint64_t)M.col[t] + seed));
+    return y;
+}
+
+int main(int argc, char** argv) {
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    int rank = 0, size = 1;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    Args args = parse_args(argc, argv);
+    const bool gemm = args.op == "spgemm";
+    const bool ell = !gemm && args.format == "ell";
+    const uint64_t seedA = 1, seedB = 2, seedX = 3;
+
+    double t0 = MPI_Wtime();
+    std::vector<int64_t> bounds = rows_even(args.n, size);
+    CSR A = build_rows(args, seedA, bounds[rank], bounds[rank + 1]);
+    if (!args.rows_split) {
+        std::vector<int64_t> prov = bounds;
+        bounds = partition_rows(args, A, prov[rank], size, MPI_COMM_WORLD);
+        A = move_rows(A, prov[rank], prov, bounds[rank], bounds[rank + 1], size, MPI_COMM_WORLD);
+    }
+    const int64_t lo = bounds[rank], hi = bounds[rank + 1], nloc = hi - lo;
+    CSR Bs;                       // B esparsa (spgemm)
+    std::vector<double> Bd;       // B densa nloc x k (spmm)
+    if (gemm) Bs = build_rows(args, seedB, lo, hi);
+    else {
+        Bd.resize((size_t) nloc * args.k);
+        for (int64_t i = 0; i < nloc; ++i)
+            for (int q = 0; q < args.k; ++q)
+                Bd[(size_t) i * args.k + q] = value(mix64((uint64_t)(lo + i) * args.k + q + seedB));
+    }
+    double t1 = MPI_Wtime();
+
+    // Troca: so as linhas de B referenciadas por colunas de A
+    Halo halo = plan_halo(A, lo, hi, bounds, size, MPI_COMM_WORLD);
+    std::vector<int64_t> cidx = compact_columns(A, halo, lo, hi);
+    std::vector<double> Bd_remote;
+    CSR Bs_remote;
+    if (gemm) Bs_remote = fetch_csr(halo, Bs, lo, size, MPI_COMM_WORLD);
+    else Bd_remote = fetch_dense(halo, Bd, args.k, lo, size, MPI_COMM_WORLD);
+    double t2 = MPI_Wtime();
+
+    // Conversao para ELL (fora do tempo do produto, reportada a parte)
+    ELL Ae;
+    if (ell) Ae = to_ell(A, cidx);
+    double t2e = MPI_Wtime();
+
+    // Produto local
+    CSR Cs;
+    std::vector<double> Cd;
+    if (gemm) Cs = spgemm(A, cidx, Bs, Bs_remote, nloc, args.n);
+    else {
+        Cd.resize((size_t) nloc * args.k);
+        if (ell) spmm_ell(Ae, Bd.data(), Bd_remote.data(), nloc, args.k, Cd.data());
+        else spmm(A, cidx, Bd.data(), Bd_remote.data(), nloc, args.k, Cd.data());
+    }
+    double t3 = MPI_Wtime();
+
+    // Estatisticas: nnz e tempo por rank (desbalanceamento), volume trocado
+    double bytes_in = gemm ? (double) Bs_remote.col.size() * 16 + (double) halo.rows.size() * 8
+                           : (double) Bd_remote.size() * 8;
+    double loc[8] = { (double) A.col.size(), t3 - t2e, bytes_in, (double) halo.rows.size(),
+                      gemm ? (double) Cs.col.size() : 0.0, t2 - t1, (double) Ae.col.size(), t2e - t2 };
+    double sum[8], mx[8];
+    MPI_Reduce(loc, sum, 8, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(loc, mx, 8, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        std::printf("%s | N=%lld | nnz(A)=%.0f (%.1f/linha, skew %.2f, band %lld) | %d ranks x %d threads | divisao por %s | A em %s\n",
+                    gemm ? "SpGEMM" : "SpMM", (long long) args.n, sum[0], sum[0] / args.n, args.skew,
+                    (long long) args.band, size, mk_num_threads(), args.rows_split ? "linhas" : "nnz",
+                    ell ? "ELL" : "CSR");
+        if (ell)
+            std::printf("ELL em fatias de %d linhas (ordenadas em janelas de %d): %.0f posicoes (%.2fx o nnz) | conversao: max %.3f s\n",
+                        ELL_C, ELL_SIGMA, sum[6], sum[6] / (sum[0] > 0 ? sum[0] : 1.0), mx[7]);
+        std::printf("nnz por rank: max/media = %.2f | calculo: max %.3f s, max/media = %.2f\n",
+                    mx[0] / (sum[0] / size), mx[1], mx[1] / (sum[1] / size));
+        std::printf("Linhas de B recebidas: %.0f (%.2f%% de N por rank, media) | %.1f MB no total | troca: %.3f s\n",
+                    sum[3], 100.0 * sum[3] / size / args.n, sum[2] / 1e6, mx[5]);
+        if (gemm) std::printf("nnz(C) = %.0f\n", sum[4]);
+        std::printf("Tempo: geracao %.3f s | troca %.3f s | produto %.3f s | total %.3f s\n",
+                    t1 - t0, t2 - t1, t3 - t2e, t3 - t0);
+    }
+
+    // Conferencia: C*x == A*(B*x), com x por hash; B*x e local a cada dono e so
+    // os valores de (B*x) nas colunas remotas de A sao trocados
+    if (args.check) {
+        std::vector<double> y1(nloc, 0.0), z(nloc, 0.0);
+        if (gemm) {
+            y1 = csr_times_hashed(Cs, seedX);
+            z = csr_times_hashed(Bs, seedX);
+        } else {
+            for (int64_t i = 0; i < nloc; ++i)
+                for (int q = 0; q < args.k; ++q) {
+                    double x = value(mix64((uint64_t) q + seedX));
+                    y1[i] += Cd[(size_t) i * args.k + q] * x;
+                    z[i] += Bd[(size_t) i * args.k + q] * x;
+                }
+        }
+        std::vector<double> zr = fetch_dense(halo, z, 1, lo, size, MPI_COMM_WORLD);
+        double err = 0.0, ref = 0.0;
+        for (int64_t i = 0; i < nloc; ++i) {
+            double y2 = 0.0;
+            for (int64_t t = A.ptr[i]; t < A.ptr[i+1]; ++t) {
+                int64_t j = cidx[t];
+                y2 += A.val[t] * (j < nloc ? z[j] : zr[j - nloc]);
+            }
+            err = std::max(err, std::fabs(y1[i] - y2));
+            ref = std::max(ref, std::fabs(y2));
+        }
+        double le[2] = { err, ref }, ge[2];
+        MPI_Reduce(le, ge, 2, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+        if (rank == 0)
+            std::printf("Conferencia C*x vs A*(B*x): max |diff| = %.3e (relativo %.3e)\n",
+                        ge[0], ge[1] > 0 ? ge[0] / ge[1] : 0.0);
+    }
+
+    MPI_Finalize();
+    return 0;
+}
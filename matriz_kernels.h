@@ -0,0 +1,555 @@
+/* matriz_kernels.h
+ * Kernels de multiplicacao de matrizes compartilhados pelos programas de matriz
+ * (matriz.cpp, naiara_yan/naiaramultimatrizotimizado_mpi.c, ...).
+ * Header unico, compativel com C e C++; todas as matrizes sao row-major com
+ * leading dimension explicita (lda, ldb, ldc).
+ *
+ * dgemm_naive   : laco original k, i, j (C = A*B), mantido como referencia
+ * dgemm_blocked : GEMM empacotado no estilo GotoBLAS/BLIS
+ *     - B e empacotado em blocos KC x NC (cabe no L3) em micro-paineis de NR colunas
+ *     - A e empacotado em blocos MC x KC (cabe no L2) em micro-paineis de MR linhas
+ *     - o micro-kernel MR x NR mantem o bloco de C em registradores (FMA/SIMD) e
+ *       percorre um micro-painel de B que fica no L1
+ *   O micro-kernel e escolhido em tempo de execucao pela CPU (avx512, avx2, generic).
+ *   Compilado com -fopenmp, dgemm_blocked divide o trabalho entre OMP_NUM_THREADS
+ *   threads (um rank por no/NUMA em vez de um rank por core).
+ * dgemm_strassen: Strassen-Winograd recursivo sobre o dgemm_blocked, com cutoff
+ *   ajustavel para o algoritmo classico
+ * sgemm_* / mgemm_* (so C++): o mesmo GEMM para float32 e para float32 com
+ *   acumulacao em float64; gemm_plan<TI, TA> e gemm_blocked/gemm_naive sobrecarregados
+ *   escolhem a versao pelo tipo.
+ * <pfx>_freivalds_bx/_res + mk_rand_unit: teste de Freivalds do produto (veja abaixo)
+ * O GEMM empacotado (empacotamento, macro-kernel, divisao entre threads, planos)
+ * esta escrito uma vez em matriz_kernels_gemm.h e e instanciado aqui para cada par
+ * de tipos; so os micro-kernels SIMD sao especificos de cada tipo.
+ */
+#ifndef MATRIZ_KERNELS_H
+#define MATRIZ_KERNELS_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#define MK_OMP(x) _Pragma(#x)
+#else
+#define MK_OMP(x)
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MK_X86 1
+#endif
+
+#define MK_MR_MAX 8
+#define MK_NR_MAX 32   /* float32 avx512: 8 x 32 */
+#define MK_ALIGN 64
+#define MK_HUGEPAGE (2u << 20)
+/* Abaixo disso o C e zerado por uma thread so (dgemm_blocked e mk_first_touch) */
+#define MK_PAR_ROWS 64
+#define MK_CAT2(a, b) a##b
+#define MK_CAT(a, b) MK_CAT2(a, b)
+#define MK_FN(x) MK_CAT(MK_PFX, x)   /* nomes dentro de matriz_kernels_gemm.h */
+
+/* A CPU tem o conjunto de instrucoes do kernel com esse nome? */
+static inline int mk_isa_supported(const char *name)
+{
+#ifdef MK_X86
+    if (strcmp(name, "avx512") == 0) return __builtin_cpu_supports("avx512f");
+    if (strcmp(name, "avx2") == 0) return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+    (void)name;
+    return 1;
+}
+
+#ifdef MK_X86
+/* AVX2: 6 x 8 (12 acumuladores ymm + 2 cargas de B + 1 broadcast) */
+__attribute__((target("avx2,fma")))
+static void dgemm_ukr_avx2_6x8(int kc, const double *A, const double *B, double *C, int ldc)
+{
+    __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+    __m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+    __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+    __m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+    __m256d c40 = _mm256_setzero_pd(), c41 = _mm256_setzero_pd();
+    __m256d c50 = _mm256_setzero_pd(), c51 = _mm256_setzero_pd();
+    int p;
+    for (p = 0; p < kc; p++) {
+        __m256d b0 = _mm256_load_pd(B);
+        __m256d b1 = _mm256_load_pd(B + 4);
+        __m256d a;
+        a = _mm256_broadcast_sd(A + 0); c00 = _mm256_fmadd_pd(a, b0, c00); c01 = _mm256_fmadd_pd(a, b1, c01);
+        a = _mm256_broadcast_sd(A + 1); c10 = _mm256_fmadd_pd(a, b0, c10); c11 = _mm256_fmadd_pd(a, b1, c11);
+        a = _mm256_broadcast_sd(A + 2); c20 = _mm256_fmadd_pd(a, b0, c20); c21 = _mm256_fmadd_pd(a, b1, c21);
+        a = _mm256_broadcast_sd(A + 3); c30 = _mm256_fmadd_pd(a, b0, c30); c31 = _mm256_fmadd_pd(a, b1, c31);
+        a = _mm256_broadcast_sd(A + 4); c40 = _mm256_fmadd_pd(a, b0, c40); c41 = _mm256_fmadd_pd(a, b1, c41);
+        a = _mm256_broadcast_sd(A + 5); c50 = _mm256_fmadd_pd(a, b0, c50); c51 = _mm256_fmadd_pd(a, b1, c51);
+        A += 6;
+        B += 8;
+    }
+#define MK_STORE2(row, lo, hi) \
+    _mm256_storeu_pd(C + (size_t)(row) * ldc,     _mm256_add_pd(_mm256_loadu_pd(C + (size_t)(row) * ldc), lo)); \
+    _mm256_storeu_pd(C + (size_t)(row) * ldc + 4, _mm256_add_pd(_mm256_loadu_pd(C + (size_t)(row) * ldc + 4), hi));
+    MK_STORE2(0, c00, c01) MK_STORE2(1, c10, c11) MK_STORE2(2, c20, c21)
+    MK_STORE2(3, c30, c31) MK_STORE2(4, c40, c41) MK_STORE2(5, c50, c51)
+#undef MK_STORE2
+}
+
+/* AVX-512: 8 x 16 (16 acumuladores zmm cobrem a latencia das duas unidades FMA) */
+__attribute__((target("avx512f")))
+static void dgemm_ukr_avx512_8x16(int kc, const double *A, const double *B, double *C, int ldc)
+{
+    __m512d c[8][2];
+    int p, i;
+    for (i = 0; i < 8; i++) { c[i][0] = _mm512_setzero_pd(); c[i][1] = _mm512_setzero_pd(); }
+    for (p = 0; p < kc; p++) {
+        __m512d b0 = _mm512_load_pd(B);
+        __m512d b1 = _mm512_load_pd(B + 8);
+#pragma GCC unroll 8
+        for (i = 0; i < 8; i++) {
+            __m512d a = _mm512_set1_pd(A[i]);
+            c[i][0] = _mm512_fmadd_pd(a, b0, c[i][0]);
+            c[i][1] = _mm512_fmadd_pd(a, b1, c[i][1]);
+        }
+        A += 8;
+        B += 16;
+    }
+    for (i = 0; i < 8; i++) {
+        double *ci = C + (size_t)i * ldc;
+        _mm512_storeu_pd(ci,     _mm512_add_pd(_mm512_loadu_pd(ci),     c[i][0]));
+        _mm512_storeu_pd(ci + 8, _mm512_add_pd(_mm512_loadu_pd(ci + 8), c[i][1]));
+    }
+}
+#endif
+
+static inline void *mk_aligned_alloc(size_t bytes)
+{
+    void *ptr = NULL;
+    if (posix_memalign(&ptr, MK_ALIGN, bytes ? bytes : MK_ALIGN) != 0) return NULL;
+    return ptr;
+}
+
+/* Matriz rows x cols alinhada em 64 bytes. Blocos de 2 MB ou mais sao alinhados
+ * a 2 MB e marcados com MADV_HUGEPAGE (huge pages transparentes no Linux), o que
+ * reduz falhas de TLB ao percorrer B em matrizes grandes. */
+static inline double *mk_matrix_alloc(size_t rows, size_t cols)
+{
+    size_t bytes = sizeof(double) * rows * cols;
+    void *ptr = NULL;
+    if (bytes >= MK_HUGEPAGE) {
+        bytes = (bytes + MK_HUGEPAGE - 1) / MK_HUGEPAGE * MK_HUGEPAGE;
+        if (posix_memalign(&ptr, MK_HUGEPAGE, bytes) != 0) return NULL;
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        madvise(ptr, bytes, MADV_HUGEPAGE);
+#endif
+        return (double *)ptr;
+    }
+    return (double *)mk_aligned_alloc(bytes);
+}
+
+static inline void mk_matrix_free(double *m)
+{
+    free(m);
+}
+
+/* Numero de threads que o dgemm_blocked usa (1 sem OpenMP) */
+static inline int mk_num_threads(void)
+{
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+/* First-touch de A e C: zera a matriz com as threads na divisao estatica de linhas
+ * (uma thread so ate MK_PAR_ROWS linhas), a mesma com que o dgemm_blocked zera C;
+ * os blocos MC de A e C tambem vao em fatias contiguas de linhas para as threads.
+ * Assim cada pagina fica no no NUMA de quem vai usa-la. Chamar logo apos
+ * mk_matrix_alloc, antes de qualquer outra escrita. */
+static inline void mk_first_touch_bytes(void *M, size_t rows, size_t row_bytes)
+{
+    long i;
+    MK_OMP(omp parallel for schedule(static) if (rows > MK_PAR_ROWS))
+    for (i = 0; i < (long)rows; i++)
+        memset((char *)M + (size_t)i * row_bytes, 0, row_bytes);
+}
+
+static inline void mk_first_touch(double *M, size_t rows, size_t cols)
+{
+    mk_first_touch_bytes(M, rows, sizeof(double) * cols);
+}
+
+/* First-touch de B (rows x cols, elementos de elem bytes) na divisao do empacotamento
+ * do dgemm_blocked: em cada bloco de nc colunas os micro-paineis de nr colunas vao
+ * estaticamente para as threads, e cada thread le todas as linhas dos seus paineis.
+ * Zerando na mesma divisao, as paginas de cada faixa de colunas ficam com quem as le
+ * (quando uma faixa ocupa ao menos uma pagina; com huge pages nao ha como separar).
+ * nc e o numero de colunas de B por chamada (plan->nc, ou menos se o chamador passa
+ * paineis mais estreitos). */
+static inline void mk_first_touch_panels(void *M, size_t rows, size_t cols, size_t elem,
+                                         int nr, int nc)
+{
+    size_t row_bytes = elem * cols;
+    MK_OMP(omp parallel)
+    {
+        long jc, jr;
+        size_t i;
+        for (jc = 0; jc < (long)cols; jc += nc) {
+            long w = (long)cols - jc < nc ? (long)cols - jc : nc;
+            MK_OMP(omp for schedule(static))
+            for (jr = 0; jr < w; jr += nr) {
+                size_t width = (size_t)(w - jr < nr ? w - jr : nr);
+                for (i = 0; i < rows; i++)
+                    memset((char *)M + i * row_bytes + elem * (size_t)(jc + jr), 0, elem * width);
+            }
+        }
+    }
+}
+
+/* Numero em [-1, 1) a partir de um hash (splitmix64) de (idx, seed): entradas de
+ * teste que qualquer rank regenera pelo indice global, e o x do teste de Freivalds */
+static inline double mk_rand_unit(uint64_t idx, uint64_t seed)
+{
+    uint64_t z = idx * 0x9E3779B97F4A7C15ULL + seed;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    return (double)(z >> 11) * 0x1.0p-52 - 1.0;
+}
+
+/* Teste de Freivalds de C = A*B (n x n) com `rounds` vetores x, em O(n^2) por vetor.
+ * x tem rounds*n entradas mk_rand_unit(e, seed). Dividido em duas metades para que
+ * o programa MPI some y entre os ranks no meio:
+ *   <pfx>_freivalds_bx : linhas [i0, i1) de y = Bx e de |B||x| (o resto de y fica 0)
+ *   (soma de y entre os ranks, p.ex. MPI_Allreduce)
+ *   <pfx>_freivalds_res: maior r_i = |A(Bx) - Cx|_i / (|A|(|B||x|) + |C||x|)_i nas
+ *                        linhas de A e C dadas
+ * Tudo em double. Para um produto correto r_i e da ordem de n*eps do tipo de C.
+ * Um erro d em c_ij soma |d x_j| ao numerador, e r_i cresce so cerca de
+ * |d x_j| / sum_k (|A||B|)_ik |x_k|: d relativo a escala da linha, que cresce com n.
+ * r nao salta para O(1); corrupcoes pequenas (bits baixos da mantissa) ficam
+ * perto do piso e so sao vistas quando |d| passa da tolerancia vezes essa escala.
+ * Os programas aceitam r <= MK_FREIVALDS_TOL(n, eps do tipo de C). */
+#define MK_FREIVALDS_TOL(n, eps) (4.0 * (double)(n) * (eps))
+
+static inline void mk_freivalds_x(int n, int rounds, uint64_t seed, double *x)
+{
+    size_t e, nx = (size_t)n * rounds;
+    for (e = 0; e < nx; e++)
+        x[e] = mk_rand_unit(e, seed);
+}
+
+/* GEMM em float64 */
+#define MK_PFX dgemm
+#define MK_TI double
+#define MK_TA double
+#ifdef MK_X86
+#define MK_SIMD_KERNELS \
+    { "avx512", 8, 16, dgemm_ukr_avx512_8x16 }, \
+    { "avx2",   6,  8, dgemm_ukr_avx2_6x8 },
+#else
+#define MK_SIMD_KERNELS
+#endif
+#include "matriz_kernels_gemm.h"
+
+/* Z = X + s*Y (s = +1 ou -1), blocos m x n */
+static inline void mk_add(int m, int n, double *Z, int ldz,
+                          const double *X, int ldx, const double *Y, int ldy, double s)
+{
+    int i, j;
+    MK_OMP(omp parallel for private(j) schedule(static) if (m > 64))
+    for (i = 0; i < m; i++) {
+        double *z = Z + (size_t)i * ldz;
+        const double *x = X + (size_t)i * ldx, *y = Y + (size_t)i * ldy;
+        for (j = 0; j < n; j++) z[j] = x[j] + s * y[j];
+    }
+}
+
+/* C = A*B (n x n) por Strassen-Winograd: 7 produtos e 15 somas por nivel, recursivo
+ * ate n <= cutoff (ou n impar), onde cai no dgemm_blocked. Usa o escalonamento de
+ * Boyer, Dumas, Pernet e Zhou (2009): os quadrantes de C servem de rascunho e so
+ * dois temporarios X e Y de (n/2)^2 sao alocados por nivel (~2n^2/3 no total).
+ * C nao pode se sobrepor a A nem a B. */
+static inline void dgemm_strassen(const dgemm_plan_t *plan, int n,
+                                  const double *A, int lda,
+                                  const double *B, int ldb,
+                                  double *C, int ldc, int cutoff)
+{
+    int h = n / 2;
+    const double *A11, *A12, *A21, *A22, *B11, *B12, *B21, *B22;
+    double *C11, *C12, *C21, *C22, *X, *Y;
+
+    if (n <= cutoff || n % 2) {
+        dgemm_blocked(plan, n, n, n, A, lda, B, ldb, 0, C, ldc);
+        return;
+    }
+    A11 = A; A12 = A + h; A21 = A + (size_t)h * lda; A22 = A21 + h;
+    B11 = B; B12 = B + h; B21 = B + (size_t)h * ldb; B22 = B21 + h;
+    C11 = C; C12 = C + h; C21 = C + (size_t)h * ldc; C22 = C21 + h;
+    X = mk_matrix_alloc(h, h);
+    Y = mk_matrix_alloc(h, h);
+
+    mk_add(h, h, X, h, A11, lda, A21, lda, -1.0);              /* S3 = A11 - A21 */
+    mk_add(h, h, Y, h, B22, ldb, B12, ldb, -1.0);              /* T3 = B22 - B12 */
+    dgemm_strassen(plan, h, X, h, Y, h, C21, ldc, cutoff);     /* P7 = S3 T3     */
+    mk_add(h, h, X, h, A21, lda, A22, lda, 1.0);               /* S1 = A21 + A22 */
+    mk_add(h, h, Y, h, B12, ldb, B11, ldb, -1.0);              /* T1 = B12 - B11 */
+    dgemm_strassen(plan, h, X, h, Y, h, C22, ldc, cutoff);     /* P5 = S1 T1     */
+    mk_add(h, h, X, h, X, h, A11, lda, -1.0);                  /* S2 = S1 - A11  */
+    mk_add(h, h, Y, h, B22, ldb, Y, h, -1.0);                  /* T2 = B22 - T1  */
+    dgemm_strassen(plan, h, X, h, Y, h, C12, ldc, cutoff);     /* P6 = S2 T2     */
+    mk_add(h, h, X, h, A12, lda, X, h, -1.0);                  /* S4 = A12 - S2  */
+    dgemm_strassen(plan, h, X, h, B22, ldb, C11, ldc, cutoff); /* P3 = S4 B22    */
+    dgemm_strassen(plan, h, A11, lda, B11, ldb, X, h, cutoff); /* P1 = A11 B11   */
+    mk_add(h, h, C12, ldc, X, h, C12, ldc, 1.0);               /* U2 = P1 + P6   */
+    mk_add(h, h, C21, ldc, C12, ldc, C21, ldc, 1.0);           /* U3 = U2 + P7   */
+    mk_add(h, h, C12, ldc, C12, ldc, C22, ldc, 1.0);           /* U4 = U2 + P5   */
+    mk_add(h, h, C22, ldc, C21, ldc, C22, ldc, 1.0);           /* C22 = U3 + P5  */
+    mk_add(h, h, C12, ldc, C12, ldc, C11, ldc, 1.0);           /* C12 = U4 + P3  */
+    mk_add(h, h, Y, h, Y, h, B21, ldb, -1.0);                  /* T4 = T2 - B21  */
+    dgemm_strassen(plan, h, A22, lda, Y, h, C11, ldc, cutoff); /* P4 = A22 T4    */
+    mk_add(h, h, C21, ldc, C21, ldc, C11, ldc, -1.0);          /* C21 = U3 - P4  */
+    dgemm_strassen(plan, h, A12, lda, B21, ldb, C11, ldc, cutoff); /* P2 = A12 B21 */
+    mk_add(h, h, C11, ldc, X, h, C11, ldc, 1.0);               /* C11 = P1 + P2  */
+
+    mk_matrix_free(X);
+    mk_matrix_free(Y);
+}
+
+#ifdef __cplusplus
+#ifdef MK_X86
+/* float32: mesmo formato dos kernels double, com o dobro de colunas por registrador */
+__attribute__((target("avx2,fma")))
+static void sgemm_ukr_avx2_6x16(int kc, const float *A, const float *B, float *C, int ldc)
+{
+    __m256 c[6][2];
+    int p, i;
+    for (i = 0; i < 6; i++) { c[i][0] = _mm256_setzero_ps(); c[i][1] = _mm256_setzero_ps(); }
+    for (p = 0; p < kc; p++) {
+        __m256 b0 = _mm256_load_ps(B), b1 = _mm256_load_ps(B + 8);
+#pragma GCC unroll 6
+        for (i = 0; i < 6; i++) {
+            __m256 a = _mm256_broadcast_ss(A + i);
+            c[i][0] = _mm256_fmadd_ps(a, b0, c[i][0]);
+            c[i][1] = _mm256_fmadd_ps(a, b1, c[i][1]);
+        }
+        A += 6;
+        B += 16;
+    }
+    for (i = 0; i < 6; i++) {
+        float *ci = C + (size_t)i * ldc;
+        _mm256_storeu_ps(ci,     _mm256_add_ps(_mm256_loadu_ps(ci),     c[i][0]));
+        _mm256_storeu_ps(ci + 8, _mm256_add_ps(_mm256_loadu_ps(ci + 8), c[i][1]));
+    }
+}
+
+__attribute__((target("avx512f")))
+static void sgemm_ukr_avx512_8x32(int kc, const float *A, const float *B, float *C, int ldc)
+{
+    __m512 c[8][2];
+    int p, i;
+    for (i = 0; i < 8; i++) { c[i][0] = _mm512_setzero_ps(); c[i][1] = _mm512_setzero_ps(); }
+    for (p = 0; p < kc; p++) {
+        __m512 b0 = _mm512_load_ps(B), b1 = _mm512_load_ps(B + 16);
+#pragma GCC unroll 8
+        for (i = 0; i < 8; i++) {
+            __m512 a = _mm512_set1_ps(A[i]);
+            c[i][0] = _mm512_fmadd_ps(a, b0, c[i][0]);
+            c[i][1] = _mm512_fmadd_ps(a, b1, c[i][1]);
+        }
+        A += 8;
+        B += 32;
+    }
+    for (i = 0; i < 8; i++) {
+        float *ci = C + (size_t)i * ldc;
+        _mm512_storeu_ps(ci,      _mm512_add_ps(_mm512_loadu_ps(ci),      c[i][0]));
+        _mm512_storeu_ps(ci + 16, _mm512_add_ps(_mm512_loadu_ps(ci + 16), c[i][1]));
+    }
+}
+
+/* Misto: A e B em float32 (metade dos bytes empacotados), convertidos para
+ * float64 no registrador; produtos e acumulacao em float64 */
+__attribute__((target("avx2,fma")))
+static void mgemm_ukr_avx2_6x8(int kc, const float *A, const float *B, double *C, int ldc)
+{
+    __m256d c[6][2];
+    int p, i;
+    for (i = 0; i < 6; i++) { c[i][0] = _mm256_setzero_pd(); c[i][1] = _mm256_setzero_pd(); }
+    for (p = 0; p < kc; p++) {
+        __m256d b0 = _mm256_cvtps_pd(_mm_load_ps(B)), b1 = _mm256_cvtps_pd(_mm_load_ps(B + 4));
+#pragma GCC unroll 6
+        for (i = 0; i < 6; i++) {
+            __m256d a = _mm256_set1_pd((double)A[i]);
+            c[i][0] = _mm256_fmadd_pd(a, b0, c[i][0]);
+            c[i][1] = _mm256_fmadd_pd(a, b1, c[i][1]);
+        }
+        A += 6;
+        B += 8;
+    }
+    for (i = 0; i < 6; i++) {
+        double *ci = C + (size_t)i * ldc;
+        _mm256_storeu_pd(ci,     _mm256_add_pd(_mm256_loadu_pd(ci),     c[i][0]));
+        _mm256_storeu_pd(ci + 4, _mm256_add_pd(_mm256_loadu_pd(ci + 4), c[i][1]));
+    }
+}
+
+__attribute__((target("avx512f")))
+static void mgemm_ukr_avx512_8x16(int kc, const float *A, const float *B, double *C, int ldc)
+{
+    __m512d c[8][2];
+    int p, i;
+    for (i = 0; i < 8; i++) { c[i][0] = _mm512_setzero_pd(); c[i][1] = _mm512_setzero_pd(); }
+    for (p = 0; p < kc; p++) {
+        __m512d b0 = _mm512_cvtps_pd(_mm256_load_ps(B)), b1 = _mm512_cvtps_pd(_mm256_load_ps(B + 8));
+#pragma GCC unroll 8
+        for (i = 0; i < 8; i++) {
+            __m512d a = _mm512_set1_pd((double)A[i]);
+            c[i][0] = _mm512_fmadd_pd(a, b0, c[i][0]);
+            c[i][1] = _mm512_fmadd_pd(a, b1, c[i][1]);
+        }
+        A += 8;
+        B += 16;
+    }
+    for (i = 0; i < 8; i++) {
+        double *ci = C + (size_t)i * ldc;
+        _mm512_storeu_pd(ci,     _mm512_add_pd(_mm512_loadu_pd(ci),     c[i][0]));
+        _mm512_storeu_pd(ci + 8, _mm512_add_pd(_mm512_loadu_pd(ci + 8), c[i][1]));
+    }
+}
+#endif
+
+/* GEMM em float32 (dobro de lanes por registrador) */
+#define MK_PFX sgemm
+#define MK_TI float
+#define MK_TA float
+#ifdef MK_X86
+#define MK_SIMD_KERNELS \
+    { "avx512", 8, 32, sgemm_ukr_avx512_8x32 }, \
+    { "avx2",   6, 16, sgemm_ukr_avx2_6x16 },
+#else
+#define MK_SIMD_KERNELS
+#endif
+#include "matriz_kernels_gemm.h"
+
+/* Misto: entradas float32, produtos e somas em float64 */
+#define MK_PFX mgemm
+#define MK_TI float
+#define MK_TA double
+#ifdef MK_X86
+#define MK_SIMD_KERNELS \
+    { "avx512", 8, 16, mgemm_ukr_avx512_8x16 }, \
+    { "avx2",   6,  8, mgemm_ukr_avx2_6x8 },
+#else
+#define MK_SIMD_KERNELS
+#endif
+#include "matriz_kernels_gemm.h"
+
+/* Nomes genericos no tipo para o codigo C++: TI e o tipo dos elementos de A e B (o
+ * que e guardado e transmitido), TA o tipo do acumulador e de C.
+ *   <double, double> : dgemm_*
+ *   <float, float>   : sgemm_*
+ *   <float, double>  : mgemm_* */
+template <typename TI, typename TA> struct gemm_tipos;
+template <> struct gemm_tipos<double, double> {
+    typedef dgemm_plan_t plan_t;
+    static plan_t plan(const char *k, int mc, int kc, int nc) { return dgemm_plan(k, mc, kc, nc); }
+};
+template <> struct gemm_tipos<float, float> {
+    typedef sgemm_plan_t plan_t;
+    static plan_t plan(const char *k, int mc, int kc, int nc) { return sgemm_plan(k, mc, kc, nc); }
+};
+template <> struct gemm_tipos<float, double> {
+    typedef mgemm_plan_t plan_t;
+    static plan_t plan(const char *k, int mc, int kc, int nc) { return mgemm_plan(k, mc, kc, nc); }
+};
+
+template <typename TI, typename TA>
+using gemm_plan_t = typename gemm_tipos<TI, TA>::plan_t;
+
+template <typename TI, typename TA>
+static inline gemm_plan_t<TI, TA> gemm_plan(const char *kernel_name, int mc = 0, int kc = 0, int nc = 0)
+{
+    return gemm_tipos<TI, TA>::plan(kernel_name, mc, kc, nc);
+}
+
+static inline void gemm_blocked(const dgemm_plan_t *plan, int m, int n, int k, const double *A, int lda,
+                                const double *B, int ldb, int beta, double *C, int ldc)
+{
+    dgemm_blocked(plan, m, n, k, A, lda, B, ldb, beta, C, ldc);
+}
+
+static inline void gemm_blocked(const sgemm_plan_t *plan, int m, int n, int k, const float *A, int lda,
+                                const float *B, int ldb, int beta, float *C, int ldc)
+{
+    sgemm_blocked(plan, m, n, k, A, lda, B, ldb, beta, C, ldc);
+}
+
+static inline void gemm_blocked(const mgemm_plan_t *plan, int m, int n, int k, const float *A, int lda,
+                                const float *B, int ldb, int beta, double *C, int ldc)
+{
+    mgemm_blocked(plan, m, n, k, A, lda, B, ldb, beta, C, ldc);
+}
+
+static inline void gemm_naive(int m, int n, int k, const double *A, int lda, const double *B, int ldb,
+                              double *C, int ldc)
+{
+    dgemm_naive(m, n, k, A, lda, B, ldb, C, ldc);
+}
+
+static inline void gemm_naive(int m, int n, int k, const float *A, int lda, const float *B, int ldb,
+                              float *C, int ldc)
+{
+    sgemm_naive(m, n, k, A, lda, B, ldb, C, ldc);
+}
+
+static inline void gemm_naive(int m, int n, int k, const float *A, int lda, const float *B, int ldb,
+                              double *C, int ldc)
+{
+    mgemm_naive(m, n, k, A, lda, B, ldb, C, ldc);
+}
+
+static inline void freivalds_bx(int n, int rounds, const double *x, int i0, int i1,
+                                const double *B, double *y)
+{
+    dgemm_freivalds_bx(n, rounds, x, i0, i1, B, y);
+}
+
+static inline void freivalds_bx(int n, int rounds, const double *x, int i0, int i1,
+                                const float *B, double *y)
+{
+    sgemm_freivalds_bx(n, rounds, x, i0, i1, B, y);
+}
+
+static inline double freivalds_res(int n, int rounds, const double *x, const double *y, int rows,
+                                   const double *A, const double *C)
+{
+    return dgemm_freivalds_res(n, rounds, x, y, rows, A, C);
+}
+
+static inline double freivalds_res(int n, int rounds, const double *x, const double *y, int rows,
+                                   const float *A, const float *C)
+{
+    return sgemm_freivalds_res(n, rounds, x, y, rows, A, C);
+}
+
+static inline double freivalds_res(int n, int rounds, const double *x, const double *y, int rows,
+                                   const float *A, const double *C)
+{
+    return mgemm_freivalds_res(n, rounds, x, y, rows, A, C);
+}
+
+template <typename T>
+static inline T *mk_alloc(size_t rows, size_t cols)
+{
+    return (T *)mk_matrix_alloc(1, (rows * cols * sizeof(T) + sizeof(double) - 1) / sizeof(double));
+}
+
+#endif /* __cplusplus */
+
+#endif /* MATRIZ_KERNELS_H */
@@ -0,0 +1,259 @@
+/* matriz_kernels_gemm.h
+ * Corpo do GEMM empacotado, escrito uma vez e incluido por matriz_kernels.h uma vez
+ * por par de tipos (sem include guard de proposito). Antes de incluir, defina:
+ *   MK_PFX          prefixo dos nomes (dgemm, sgemm, mgemm)
+ *   MK_TI           tipo dos elementos de A e B (o que e empacotado)
+ *   MK_TA           tipo de C e do acumulador
+ *   MK_SIMD_KERNELS entradas da tabela de micro-kernels antes do generico (pode ser vazio)
+ * Define <pfx>_ukr_fn, <pfx>_kernel_t, <pfx>_plan_t, <pfx>_kernels[], <pfx>_naive,
+ * <pfx>_select_kernel, <pfx>_plan, <pfx>_pack_a, <pfx>_pack_b, <pfx>_macro_kernel,
+ * <pfx>_blocked e <pfx>_freivalds_bx/_res, e desfaz os quatro macros no fim.
+ */
+
+/* Referencia: C = A*B com o laco original dos programas (colunas de B em passo N) */
+static inline void MK_FN(_naive)(int m, int n, int k,
+                                 const MK_TI *A, int lda,
+                                 const MK_TI *B, int ldb,
+                                 MK_TA *C, int ldc)
+{
+    int i, j, kk;
+    for (kk = 0; kk < n; kk++)
+        for (i = 0; i < m; i++) {
+            MK_TA s = 0;
+            for (j = 0; j < k; j++)
+                s = s + (MK_TA)A[(size_t)i * lda + j] * (MK_TA)B[(size_t)j * ldb + kk];
+            C[(size_t)i * ldc + kk] = s;
+        }
+}
+
+/* Micro-kernel: C[MR x NR] += Ap * Bp, com Ap (kc x MR) e Bp (kc x NR) empacotados */
+typedef void (*MK_FN(_ukr_fn))(int kc, const MK_TI *Ap, const MK_TI *Bp, MK_TA *C, int ldc);
+
+typedef struct {
+    const char *name;
+    int mr, nr;
+    MK_FN(_ukr_fn) ukr;
+} MK_FN(_kernel_t);
+
+/* Kernel + tamanhos de bloco usados por <pfx>_blocked */
+typedef struct {
+    const MK_FN(_kernel_t) *kern;
+    int mc, kc, nc;
+} MK_FN(_plan_t);
+
+static void MK_FN(_ukr_generic_4x4)(int kc, const MK_TI *A, const MK_TI *B, MK_TA *C, int ldc)
+{
+    MK_TA c[4][4] = {{0}};
+    int p, i, j;
+    for (p = 0; p < kc; p++)
+        for (i = 0; i < 4; i++)
+            for (j = 0; j < 4; j++)
+                c[i][j] += (MK_TA)A[p * 4 + i] * (MK_TA)B[p * 4 + j];
+    for (i = 0; i < 4; i++)
+        for (j = 0; j < 4; j++)
+            C[(size_t)i * ldc + j] += c[i][j];
+}
+
+/* Do melhor para o mais portavel */
+static const MK_FN(_kernel_t) MK_FN(_kernels)[] = {
+    MK_SIMD_KERNELS
+    { "generic", 4, 4, MK_FN(_ukr_generic_4x4) },
+};
+
+/* Kernel pelo nome, ou o melhor suportado pela CPU (name NULL/"auto"/desconhecido) */
+static inline const MK_FN(_kernel_t) *MK_FN(_select_kernel)(const char *name)
+{
+    size_t i, nk = sizeof(MK_FN(_kernels)) / sizeof(MK_FN(_kernels)[0]);
+    if (name && strcmp(name, "auto") != 0)
+        for (i = 0; i < nk; i++)
+            if (strcmp(MK_FN(_kernels)[i].name, name) == 0 && mk_isa_supported(name))
+                return &MK_FN(_kernels)[i];
+    for (i = 0; i < nk; i++)
+        if (mk_isa_supported(MK_FN(_kernels)[i].name))
+            return &MK_FN(_kernels)[i];
+    return &MK_FN(_kernels)[nk - 1];
+}
+
+/* Blocos padrao: micro-painel de B (KC x NR) no L1, bloco de A (MC x KC) no L2,
+ * bloco de B (KC x NC) no L3. mc/nc sao arredondados para multiplos de MR/NR. */
+static inline MK_FN(_plan_t) MK_FN(_plan)(const char *kernel_name, int mc, int kc, int nc)
+{
+    MK_FN(_plan_t) p;
+    p.kern = MK_FN(_select_kernel)(kernel_name);
+    p.kc = kc > 0 ? kc : 256;
+    p.mc = mc > 0 ? mc : p.kern->mr * 16;
+    p.nc = nc > 0 ? nc : 4096;
+    p.mc = ((p.mc + p.kern->mr - 1) / p.kern->mr) * p.kern->mr;
+    p.nc = ((p.nc + p.kern->nr - 1) / p.kern->nr) * p.kern->nr;
+    return p;
+}
+
+/* Empacota A[mc x kc] em micro-paineis de mr linhas (coluna a coluna), com zeros na borda */
+static inline void MK_FN(_pack_a)(int mc, int kc, const MK_TI *A, int lda, int mr, MK_TI *Ap)
+{
+    int ir, p, i;
+    for (ir = 0; ir < mc; ir += mr) {
+        int rows = (mc - ir < mr) ? mc - ir : mr;
+        for (p = 0; p < kc; p++) {
+            for (i = 0; i < rows; i++) Ap[i] = A[(size_t)(ir + i) * lda + p];
+            for (; i < mr; i++) Ap[i] = 0;
+            Ap += mr;
+        }
+    }
+}
+
+/* Empacota B[kc x nc] em micro-paineis de nr colunas (linha a linha), com zeros na borda */
+static inline void MK_FN(_pack_b)(int kc, int nc, const MK_TI *B, int ldb, int nr, MK_TI *Bp)
+{
+    int jr, p, j;
+    for (jr = 0; jr < nc; jr += nr) {
+        int cols = (nc - jr < nr) ? nc - jr : nr;
+        for (p = 0; p < kc; p++) {
+            const MK_TI *bp = B + (size_t)p * ldb + jr;
+            for (j = 0; j < cols; j++) Bp[j] = bp[j];
+            for (; j < nr; j++) Bp[j] = 0;
+            Bp += nr;
+        }
+    }
+}
+
+/* Macro-kernel: percorre o bloco empacotado chamando o micro-kernel; bordas
+ * passam por um bloco temporario e so a parte valida e somada em C. */
+static inline void MK_FN(_macro_kernel)(const MK_FN(_kernel_t) *kern, int mc, int nc, int kc,
+                                        const MK_TI *Ap, const MK_TI *Bp, MK_TA *C, int ldc)
+{
+    MK_TA tmp[MK_MR_MAX * MK_NR_MAX] __attribute__((aligned(MK_ALIGN)));
+    int mr = kern->mr, nr = kern->nr;
+    int ir, jr, i, j;
+    for (jr = 0; jr < nc; jr += nr) {
+        int cols = (nc - jr < nr) ? nc - jr : nr;
+        const MK_TI *bp = Bp + (size_t)jr * kc;
+        for (ir = 0; ir < mc; ir += mr) {
+            int rows = (mc - ir < mr) ? mc - ir : mr;
+            const MK_TI *ap = Ap + (size_t)ir * kc;
+            MK_TA *c = C + (size_t)ir * ldc + jr;
+            if (rows == mr && cols == nr) {
+                kern->ukr(kc, ap, bp, c, ldc);
+            } else {
+                memset(tmp, 0, sizeof(tmp));
+                kern->ukr(kc, ap, bp, tmp, nr);
+                for (i = 0; i < rows; i++)
+                    for (j = 0; j < cols; j++)
+                        c[(size_t)i * ldc + j] += tmp[i * nr + j];
+            }
+        }
+    }
+}
+
+/* C = A*B (beta == 0) ou C += A*B (beta != 0); A m x k, B k x n, C m x n.
+ * Com OpenMP (-fopenmp) o bloco de B e empacotado em paralelo (um micro-painel
+ * por vez) e os blocos MC de linhas sao divididos entre as threads, cada uma com
+ * seu buffer de A; sem OpenMP os pragmas somem e o codigo e o mesmo serial. */
+static inline void MK_FN(_blocked)(const MK_FN(_plan_t) *plan, int m, int n, int k,
+                                   const MK_TI *A, int lda,
+                                   const MK_TI *B, int ldb,
+                                   int beta, MK_TA *C, int ldc)
+{
+    const MK_FN(_kernel_t) *kern = plan->kern;
+    int mr = kern->mr, nr = kern->nr;
+    int mcb = plan->mc, i;
+    MK_TI *Bp;
+
+    if (!beta) {
+        MK_OMP(omp parallel for schedule(static) if (m > MK_PAR_ROWS))
+        for (i = 0; i < m; i++) memset(C + (size_t)i * ldc, 0, sizeof(MK_TA) * (size_t)n);
+    }
+    if (m <= 0 || n <= 0 || k <= 0) return;
+
+    /* poucas linhas para muitas threads: blocos MC menores para ninguem ficar parado */
+    {
+        int nt = mk_num_threads();
+        int per = ((m + nt - 1) / nt + mr - 1) / mr * mr;
+        if (nt > 1 && per < mcb) mcb = per;
+    }
+
+    Bp = (MK_TI *)mk_aligned_alloc(sizeof(MK_TI) * (size_t)plan->kc * plan->nc);
+
+    MK_OMP(omp parallel)
+    {
+        MK_TI *Ap = (MK_TI *)mk_aligned_alloc(sizeof(MK_TI) * (size_t)mcb * plan->kc);
+        int jc, pc, ic, jr;
+
+        for (jc = 0; jc < n; jc += plan->nc) {
+            int nc = (n - jc < plan->nc) ? n - jc : plan->nc;
+            for (pc = 0; pc < k; pc += plan->kc) {
+                int kc = (k - pc < plan->kc) ? k - pc : plan->kc;
+
+                /* barreira implicita no fim de cada for: Bp pronto antes de usar,
+                 * e todos terminam de usa-lo antes do proximo empacotamento */
+                MK_OMP(omp for schedule(static))
+                for (jr = 0; jr < nc; jr += nr) {
+                    int cols = (nc - jr < nr) ? nc - jr : nr;
+                    MK_FN(_pack_b)(kc, cols, B + (size_t)pc * ldb + jc + jr, ldb, nr, Bp + (size_t)jr * kc);
+                }
+
+                MK_OMP(omp for schedule(static))
+                for (ic = 0; ic < m; ic += mcb) {
+                    int mc = (m - ic < mcb) ? m - ic : mcb;
+                    MK_FN(_pack_a)(mc, kc, A + (size_t)ic * lda + pc, lda, mr, Ap);
+                    MK_FN(_macro_kernel)(kern, mc, nc, kc, Ap, Bp, C + (size_t)ic * ldc + jc, ldc);
+                }
+            }
+        }
+        free(Ap);
+    }
+
+    free(Bp);
+}
+
+/* Metade B do teste de Freivalds (veja matriz_kernels.h): para as linhas [i0, i1) de
+ * B (n x n, ld n) y[r*n + i] = (Bx_r)_i e y[(rounds + r)*n + i] = (|B||x_r|)_i */
+static inline void MK_FN(_freivalds_bx)(int n, int rounds, const double *x, int i0, int i1,
+                                        const MK_TI *B, double *y)
+{
+    size_t nx = (size_t)n * rounds;
+    int i, r, k;
+    for (i = i0; i < i1; i++) {
+        const MK_TI *bi = B + (size_t)i * n;
+        for (r = 0; r < rounds; r++) {
+            const double *xr = x + (size_t)r * n;
+            double s = 0.0, m = 0.0;
+            for (k = 0; k < n; k++) {
+                s += (double)bi[k] * xr[k];
+                m += fabs((double)bi[k] * xr[k]);
+            }
+            y[(size_t)r * n + i] = s;
+            y[nx + (size_t)r * n + i] = m;
+        }
+    }
+}
+
+/* Metade A: maior |A(Bx) - Cx|_i / (|A|(|B||x|) + |C||x|)_i nas `rows` linhas de A e C
+ * (ld n), com y ja somado entre os ranks */
+static inline double MK_FN(_freivalds_res)(int n, int rounds, const double *x, const double *y,
+                                           int rows, const MK_TI *A, const MK_TA *C)
+{
+    size_t nx = (size_t)n * rounds;
+    double worst = 0.0;
+    int i, r, k;
+    for (i = 0; i < rows; i++) {
+        const MK_TI *ai = A + (size_t)i * n;
+        const MK_TA *ci = C + (size_t)i * n;
+        for (r = 0; r < rounds; r++) {
+            const double *xr = x + (size_t)r * n, *yr = y + (size_t)r * n, *ym = y + nx + (size_t)r * n;
+            double d = 0.0, m = 0.0;
+            for (k = 0; k < n; k++) {
+                d += (double)ai[k] * yr[k] - (double)ci[k] * xr[k];
+                m += fabs((double)ai[k]) * ym[k] + fabs((double)ci[k] * xr[k]);
+            }
+            if (m > 0.0 && fabs(d) / m > worst)
+                worst = fabs(d) / m;
+        }
+    }
+    return worst;
+}
+
+#undef MK_PFX
+#undef MK_TI
+#undef MK_TA
+#undef MK_SIMD_KERNELS
@@ -0,0 +1,431 @@
+// matriz_lote_mpi.cpp
+// GEMM em lote: milhares de produtos C = A*B independentes e pequenos (32 a 256),
+// distribuidos em blocos de problemas por uma fila master/worker.
+// Compile: mpicxx -O3 -march=native -fopenmp -std=c++17 -o matriz_lote_mpi matriz_lote_mpi.cpp
+// Execute: mpirun -np 4 ./matriz_lote_mpi -count 20000 -sizes 32,64,128 [-layout soa] [-check] [-worker-gen]
+//
+// - Fila: os problemas sao ordenados por tamanho e cortados em blocos de ate -chunk
+//   problemas do mesmo n. O master monta A e B de cada bloco ja no layout pedido,
+//   manda para o worker que devolveu o ultimo resultado e recebe C de volta; cada
+//   worker tem ate 2 blocos em voo, entao o proximo chega enquanto o atual e
+//   calculado. O master monta o bloco seguinte (com as threads) logo depois de
+//   despachar, enquanto os workers calculam, e nao no caminho do despacho.
+// - -worker-gen: modo sintetico em que o master manda so o indice do bloco e o worker
+//   gera A e B do hash do id (todo rank monta a mesma fila); mede o calculo sem o
+//   transporte das entradas, que um lote de verdade sempre paga.
+// - Kernels especializados em tempo de compilacao para n = 32, 64, 128 e 256 (blocos
+//   de C em registradores, n constante, lacos desenrolados pelo compilador); outros n
+//   usam a mesma rotina com n em tempo de execucao. -kernel blocked usa o dgemm_blocked.
+// - Layouts (-layout):
+//     aos : cada problema contiguo, row-major
+//     soa : grupos de LANES problemas intercalados, elemento (i, j) dos LANES problemas
+//           em posicoes consecutivas; o kernel opera em todos os problemas do grupo
+//           com uma instrucao SIMD por elemento, sem depender do n ser multiplo do
+//           vetor. Compensa para n pequeno (abaixo de 16); dai em diante o aos e melhor,
+//           e de 128 em diante o -kernel blocked
+// - Threads OpenMP dividem os problemas (ou grupos) de cada bloco.
+// Reporta GEMMs/s e GFLOPS de ponta a ponta no master e so do calculo nos workers.
+
+#include <mpi.h>
+#include <cstdint>
+#include <cstdio>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <deque>
+#include <sstream>
+#include <cstring>
+#include <algorithm>
+
+#include "matriz_kernels.h"
+
+enum Tags { TAG_CHUNK = 1, TAG_DATA = 2, TAG_RESULT = 3 };
+
+// problemas intercalados por grupo no layout soa (8 doubles = um registrador AVX-512)
+static const int LANES = 8;
+
+struct Args {
+    long count = 10000;                      // numero de problemas
+    std::vector<int> sizes{32, 64, 128};     // tamanhos sorteados por problema
+    int chunk = 64;                          // problemas por bloco da fila
+    std::string layout = "aos";              // aos | soa
+    std::string kernel = "fixed";            // fixed | blocked (so aos)
+    bool check = false;                      // confere o primeiro problema de cada bloco
+    bool worker_gen = false;                 // workers geram A e B (sem mandar dados)
+};
+
+static std::vector<int> parse_ints(const std::string& s) {
+    std::vector<int> v;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) if (!item.empty()) v.push_back(std::max(1, std::stoi(item)));
+    return v;
+}
+
+Args parse_args(int argc, char** argv) {
+    Args a;
+    for (int i = 1; i < argc; ++i) {
+        std::string s = argv[i];
+        if (s == "-count" && i+1<argc) a.count = std::max(1L, std::stol(argv[++i]));
+        else if (s == "-sizes" && i+1<argc) a.sizes = parse_ints(argv[++i]);
+        else if (s == "-chunk" && i+1<argc) a.chunk = std::max(1, std::stoi(argv[++i]));
+        else if (s == "-layout" && i+1<argc) a.layout = argv[++i];
+        else if (s == "-kernel" && i+1<argc) a.kernel = argv[++i];
+        else if (s == "-check") a.check = true;
+        else if (s == "-worker-gen") a.worker_gen = true;
+    }
+    if (a.sizes.empty()) a.sizes.push_back(64);
+    if (a.layout == "soa") a.chunk = (a.chunk + LANES - 1) / LANES * LANES;
+    return a;
+}
+
+// Entrada (i, j) da matriz `which` (0 = A, 1 = B) do problema id de ordem n, em [-1, 1):
+// o indice de mk_rand_unit enumera as duas matrizes de cada problema em sequencia
+static inline double entry(long id, int which, int n, int i, int j) {
+    return mk_rand_unit((((uint64_t) id * 2 + which) * n + i) * n + j, 0);
+}
+
+// ---------------- Kernels ----------------
+
+// Blocos de registradores: um bloco MB x JB de C fica em acumuladores durante todo
+// o laco em k. Os acumuladores sao vetores de 8 doubles (extensao de vetores do
+// GCC/Clang: um zmm no AVX-512, dois ymm no AVX2), o que fixa a vetorizacao na
+// dimensao certa mesmo quando n so e conhecido em tempo de execucao. Bordas que nao
+// fecham um bloco usam o laco simples.
+typedef double v8d __attribute__((vector_size(64)));
+// as funcoes com v8d sao todas internas (static inline): o aviso de ABI nao se aplica
+#pragma GCC diagnostic ignored "-Wpsabi"
+static const int MB_AOS = 8, JB_AOS = 16, MB_SOA = 4, JB_SOA = 4;
+
+static inline v8d load8(const double* p) { v8d v; memcpy(&v, p, sizeof(v)); return v; }
+static inline void store8(double* p, v8d v) { memcpy(p, &v, sizeof(v)); }
+
+// aos: bloco MB_AOS x JB_AOS de C a partir de MB_AOS linhas de A e JB_AOS colunas de B
+static inline __attribute__((always_inline))
+void aos_tile(int n, const double* A, const double* B, double* C) {
+    v8d acc[MB_AOS][2] = {};
+    for (int k = 0; k < n; ++k) {
+        v8d b0 = load8(B + (size_t) k * n), b1 = load8(B + (size_t) k * n + 8);
+        for (int r = 0; r < MB_AOS; ++r) {
+            double a = A[(size_t) r * n + k];
+            acc[r][0] += a * b0;
+            acc[r][1] += a * b1;
+        }
+    }
+    for (int r = 0; r < MB_AOS; ++r) {
+        store8(C + (size_t) r * n, acc[r][0]);
+        store8(C + (size_t) r * n + 8, acc[r][1]);
+    }
+}
+
+// aos: C = A*B de um problema n x n (n constante de compilacao quando NF != 0)
+template <int NF>
+static void gemm_aos(int n_rt, const double* A, const double* B, double* C) {
+    const int n = NF ? NF : n_rt;
+    if (n % MB_AOS == 0 && n % JB_AOS == 0) {
+        for (int i0 = 0; i0 < n; i0 += MB_AOS)
+            for (int j0 = 0; j0 < n; j0 += JB_AOS)
+                aos_tile(n, A + (size_t) i0 * n, B + j0, C + (size_t) i0 * n + j0);
+        return;
+    }
+    for (int i = 0; i < n; ++i) {
+        double* c = C + (size_t) i * n;
+        for (int j = 0; j < n; ++j) c[j] = 0.0;
+        for (int k = 0; k < n; ++k) {
+            double a = A[(size_t) i * n + k];
+            const double* b = B + (size_t) k * n;
+            for (int j = 0; j < n; ++j) c[j] += a * b[j];
+        }
+    }
+}
+
+// soa: LANES problemas n x n intercalados, X[(i*n + j)*LANES + l] = X_l(i, j); cada
+// elemento e um v8d com o mesmo (i, j) dos LANES problemas
+template <int NF>
+static void gemm_soa(int n_rt, const double* A, const double* B, double* C) {
+    const int n = NF ? NF : n_rt;
+    if (n % MB_SOA == 0 && n % JB_SOA == 0) {
+        for (int i0 = 0; i0 < n; i0 += MB_SOA)
+            for (int j0 = 0; j0 < n; j0 += JB_SOA) {
+                v8d acc[MB_SOA][JB_SOA] = {};
+                for (int k = 0; k < n; ++k) {
+                    v8d bk[JB_SOA];
+                    for (int j = 0; j < JB_SOA; ++j) bk[j] = load8(B + ((size_t) k * n + j0 + j) * LANES);
+                    for (int r = 0; r < MB_SOA; ++r) {
+                        v8d ar = load8(A + ((size_t)(i0 + r) * n + k) * LANES);
+                        for (int j = 0; j < JB_SOA; ++j) acc[r][j] += ar * bk[j];
+                    }
+                }
+                for (int r = 0; r < MB_SOA; ++r)
+                    for (int j = 0; j < JB_SOA; ++j)
+                        store8(C + ((size_t)(i0 + r) * n + j0 + j) * LANES, acc[r][j]);
+            }
+        return;
+    }
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j) {
+            v8d acc = {};
+            for (int k = 0; k < n; ++k)
+                acc += load8(A + ((size_t) i * n + k) * LANES) * load8(B + ((size_t) k * n + j) * LANES);
+            store8(C + ((size_t) i * n + j) * LANES, acc);
+        }
+}
+
+typedef void (*batch_fn)(int, const double*, const double*, double*);
+
+// Rotina para o tamanho n: especializada quando n e um dos tamanhos comuns
+static batch_fn select_fn(const std::string& layout, int n) {
+    if (layout == "soa") {
+        switch (n) {
+            case 32: return gemm_soa<32>;
+            case 64: return gemm_soa<64>;
+            case 128: return gemm_soa<128>;
+            case 256: return gemm_soa<256>;
+            default: return gemm_soa<0>;
+        }
+    }
+    switch (n) {
+        case 32: return gemm_aos<32>;
+        case 64: return gemm_aos<64>;
+        case 128: return gemm_aos<128>;
+        case 256: return gemm_aos<256>;
+        default: return gemm_aos<0>;
+    }
+}
+
+// Calcula um bloco de cnt problemas de ordem n (cnt ja multiplo de LANES no soa)
+static void compute_chunk(const Args& a, const dgemm_plan_t& plan, int n, int cnt,
+                          const double* A, const double* B, double* C) {
+    const size_t nn = (size_t) n * n;
+    if (a.layout == "soa") {
+        batch_fn fn = select_fn(a.layout, n);
+        int groups = cnt / LANES;
+        MK_OMP(omp parallel for schedule(static))
+        for (int g = 0; g < groups; ++g)
+            fn(n, A + g * nn * LANES, B + g * nn * LANES, C + g * nn * LANES);
+    } else if (a.kernel == "blocked") {
+        // um problema por thread: o dgemm_blocked nao abre outra regiao paralela
+        // dentro de uma regiao ativa (aninhamento desligado por padrao)
+        MK_OMP(omp parallel for schedule(dynamic, 1))
+        for (int s = 0; s < cnt; ++s)
+            dgemm_blocked(&plan, n, n, n, A + s * nn, n, B + s * nn, n, 0, C + s * nn, n);
+    } else {
+        batch_fn fn = select_fn(a.layout, n);
+        MK_OMP(omp parallel for schedule(static))
+        for (int s = 0; s < cnt; ++s)
+            fn(n, A + s * nn, B + s * nn, C + s * nn);
+    }
+}
+
+// ---------------- Fila ----------------
+
+struct Problem { long id; int n; };
+
+// Bloco da fila: problemas [first, first + cnt) da fila ordenada, todos de ordem n.
+// slots = cnt arredondado para LANES no soa (problemas extras zerados).
+struct Chunk { long first; int cnt, n, slots; };
+
+static std::vector<Chunk> make_chunks(const Args& a, const std::vector<Problem>& q) {
+    std::vector<Chunk> chunks;
+    long p = 0;
+    while (p < (long) q.size()) {
+        Chunk c;
+        c.first = p;
+        c.n = q[p].n;
+        c.cnt = 0;
+        while (p < (long) q.size() && q[p].n == c.n && c.cnt < a.chunk) { ++p; ++c.cnt; }
+        c.slots = a.layout == "soa" ? (c.cnt + LANES - 1) / LANES * LANES : c.cnt;
+        chunks.push_back(c);
+    }
+    return chunks;
+}
+
+// Posicao do elemento (i, j) do problema s do bloco, no layout pedido
+static inline size_t slot_index(bool soa, int n, int s, int i, int j) {
+    size_t nn = (size_t) n * n;
+    if (soa) return (size_t)(s / LANES) * nn * LANES + ((size_t) i * n + j) * LANES + s % LANES;
+    return (size_t) s * nn + (size_t) i * n + j;
+}
+
+// Gera A e B do bloco, com as threads dividindo os problemas; os slots extras do soa
+// ficam zerados
+static void fill_chunk(const Args& a, const std::vector<Problem>& q, const Chunk& c, double* AB) {
+    bool soa = a.layout == "soa";
+    size_t half = (size_t) c.slots * c.n * c.n;
+    MK_OMP(omp parallel for schedule(static))
+    for (int s = 0; s < c.slots; ++s) {
+        long id = s < c.cnt ? q[c.first + s].id : -1;
+        for (int i = 0; i < c.n; ++i)
+            for (int j = 0; j < c.n; ++j) {
+                size_t e = slot_index(soa, c.n, s, i, j);
+                AB[e] = id < 0 ? 0.0 : entry(id, 0, c.n, i, j);
+                AB[half + e] = id < 0 ? 0.0 : entry(id, 1, c.n, i, j);
+            }
+    }
+}
+
+// Erro relativo maximo do primeiro problema do bloco contra o produto recalculado
+static double check_chunk(const Args& a, const std::vector<Problem>& q, const Chunk& c, const double* C) {
+    bool soa = a.layout == "soa";
+    long id = q[c.first].id;
+    double err = 0.0;
+    for (int i = 0; i < c.n; ++i)
+        for (int j = 0; j < c.n; ++j) {
+            double ref = 0.0, mag = 0.0;
+            for (int k = 0; k < c.n; ++k) {
+                double p = entry(id, 0, c.n, i, k) * entry(id, 1, c.n, k, j);
+                ref += p;
+                mag += std::fabs(p);
+            }
+            err = std::max(err, std::fabs(ref - C[slot_index(soa, c.n, 0, i, j)]) / mag);
+        }
+    return err;
+}
+
+int main(int argc, char** argv) {
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    int rank = 0, size = 1;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    Args args = parse_args(argc, argv);
+    dgemm_plan_t plan = dgemm_plan("auto", 0, 0, 0);
+
+    // Fila: tamanho de cada problema sorteado por hash do id, ordenada por tamanho
+    std::vector<Problem> queue(args.count);
+    const size_t nsizes = args.sizes.size();
+    for (long p = 0; p < args.count; ++p) {
+        size_t k = (size_t)((mk_rand_unit((uint64_t) p, 12345) + 1.0) * 0.5 * nsizes);
+        queue[p] = { p, args.sizes[std::min(k, nsizes - 1)] };
+    }
+    std::stable_sort(queue.begin(), queue.end(), [](const Problem& x, const Problem& y) { return x.n < y.n; });
+    std::vector<Chunk> chunks = make_chunks(args, queue);
+    int maxn = *std::max_element(args.sizes.begin(), args.sizes.end());
+    size_t maxslots = (size_t) args.chunk * maxn * maxn;
+
+    double flops = 0.0;
+    for (const Problem& p : queue) flops += 2.0 * p.n * (double) p.n * p.n;
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    double t0 = MPI_Wtime();
+    double t_comp = 0.0, maxerr = 0.0;
+    long done = 0;
+
+    if (rank == 0 && size == 1) {
+        // sem workers: o master calcula a fila inteira
+        std::vector<double> AB(2 * maxslots), C(maxslots);
+        for (const Chunk& c : chunks) {
+            fill_chunk(args, queue, c, AB.data());
+            double tc = MPI_Wtime();
+            compute_chunk(args, plan, c.n, c.slots, AB.data(), AB.data() + (size_t) c.slots * c.n * c.n, C.data());
+            t_comp += MPI_Wtime() - tc;
+            done += c.cnt;
+            if (args.check) maxerr = std::max(maxerr, check_chunk(args, queue, c, C.data()));
+        }
+    } else if (rank == 0) {
+        // ate 2 blocos em voo por worker; cada worker devolve na ordem em que recebeu
+        const int depth = 2;
+        std::vector<std::deque<size_t>> inflight(size);
+        std::vector<std::vector<double>> sendbuf(args.worker_gen ? 0 : size * depth);
+        std::vector<MPI_Request> sendreq(sendbuf.size(), MPI_REQUEST_NULL);
+        std::vector<int> next_buf(size, 0);
+        std::vector<double> C(maxslots), pre;   // pre: bloco `next` ja montado
+        size_t next = 0;
+        bool pre_ready = false;
+        int active = size - 1;
+
+        // monta chunks[next] em pre, se ainda nao estiver
+        auto prefetch = [&]() {
+            if (args.worker_gen || pre_ready || next >= chunks.size()) return;
+            pre.resize(2 * maxslots);
+            fill_chunk(args, queue, chunks[next], pre.data());
+            pre_ready = true;
+        };
+        // manda o proximo bloco para w (ou o aviso de fim, -1)
+        auto dispatch = [&](int w) {
+            int idx = -1;
+            if (next < chunks.size()) {
+                idx = (int) next;
+                MPI_Send(&idx, 1, MPI_INT, w, TAG_CHUNK, MPI_COMM_WORLD);
+                if (!args.worker_gen) {
+                    const Chunk& c = chunks[next];
+                    int b = w * depth + next_buf[w];
+                    next_buf[w] = (next_buf[w] + 1) % depth;
+                    MPI_Wait(&sendreq[b], MPI_STATUS_IGNORE);
+                    prefetch();
+                    sendbuf[b].swap(pre);   // o buffer livre vira o proximo pre
+                    pre_ready = false;
+                    MPI_Isend(sendbuf[b].data(), (int)(2 * (size_t) c.slots * c.n * c.n), MPI_DOUBLE,
+                              w, TAG_DATA, MPI_COMM_WORLD, &sendreq[b]);
+                }
+                inflight[w].push_back(next++);
+            } else {
+                MPI_Send(&idx, 1, MPI_INT, w, TAG_CHUNK, MPI_COMM_WORLD);
+                --active;
+            }
+        };
+        for (int d = 0; d < depth; ++d)
+            for (int w = 1; w < size; ++w)
+                if (next < chunks.size()) dispatch(w);
+        // workers sem bloco nenhum ja recebem o fim
+        for (int w = 1; w < size; ++w)
+            if (inflight[w].empty()) dispatch(w);
+
+        while (active > 0) {
+            // o proximo bloco e montado enquanto os workers calculam os que ja tem
+            prefetch();
+            MPI_Status st;
+            MPI_Probe(MPI_ANY_SOURCE, TAG_RESULT, MPI_COMM_WORLD, &st);
+            int w = st.MPI_SOURCE;
+            const Chunk& c = chunks[inflight[w].front()];
+            inflight[w].pop_front();
+            MPI_Recv(C.data(), (int)((size_t) c.slots * c.n * c.n), MPI_DOUBLE, w, TAG_RESULT,
+                     MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            done += c.cnt;
+            if (args.check) maxerr = std::max(maxerr, check_chunk(args, queue, c, C.data()));
+            // o fim so vai quando o worker nao tem mais nada em voo
+            if (next < chunks.size() || inflight[w].empty()) dispatch(w);
+        }
+        MPI_Waitall((int) sendreq.size(), sendreq.data(), MPI_STATUSES_IGNORE);
+    } else {
+        std::vector<double> AB(2 * maxslots), C(maxslots);
+        for (;;) {
+            int idx;
+            MPI_Recv(&idx, 1, MPI_INT, 0, TAG_CHUNK, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            if (idx < 0) break;
+            const Chunk& c = chunks[idx];
+            size_t half = (size_t) c.slots * c.n * c.n;
+            if (args.worker_gen)
+                fill_chunk(args, queue, c, AB.data());
+            else
+                MPI_Recv(AB.data(), (int)(2 * half), MPI_DOUBLE, 0, TAG_DATA, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            double tc = MPI_Wtime();
+            compute_chunk(args, plan, c.n, c.slots, AB.data(), AB.data() + half, C.data());
+            t_comp += MPI_Wtime() - tc;
+            MPI_Send(C.data(), (int) half, MPI_DOUBLE, 0, TAG_RESULT, MPI_COMM_WORLD);
+        }
+    }
+    double elapsed = MPI_Wtime() - t0;
+
+    // tempo de calculo somado dos ranks que calcularam (o master so quando sozinho)
+    double comp_sum = 0.0;
+    MPI_Reduce(&t_comp, &comp_sum, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        int calc_ranks = size == 1 ? 1 : size - 1;
+        std::printf("Lote: %ld GEMMs (n em {", args.count);
+        for (size_t i = 0; i < args.sizes.size(); ++i) std::printf(i ? ",%d" : "%d", args.sizes[i]);
+        std::printf("}) | %zu blocos de ate %d | layout %s | kernel %s | %d ranks x %d threads%s\n",
+                    chunks.size(), args.chunk, args.layout.c_str(),
+                    args.layout == "soa" ? "soa" : args.kernel.c_str(), size, mk_num_threads(),
+                    args.worker_gen && size > 1 ? " | entradas geradas nos workers" : "");
+        std::printf("Ponta a ponta: %.3f s | %.0f GEMMs/s | %.2f GFLOPS\n",
+                    elapsed, (double) done / elapsed, flops / elapsed / 1e9);
+        if (comp_sum > 0.0)
+            std::printf("So calculo (media por rank de calculo): %.0f GEMMs/s | %.2f GFLOPS\n",
+                        (double) done / (comp_sum / calc_ranks), flops / (comp_sum / calc_ranks) / 1e9);
+        if (args.check)
+            std::printf("Conferencia (1 problema por bloco): max erro relativo = %.3g\n", maxerr);
+    }
+    MPI_Finalize();
+    return 0;
+}
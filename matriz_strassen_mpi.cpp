@@ -0,0 +1,260 @@
+// matriz_strassen_mpi.cpp
+// Multiplicacao de matrizes C = A*B com Strassen-Winograd distribuido.
+// Compile: mpicxx -O3 -march=native -fopenmp -std=c++17 -o matriz_strassen_mpi matriz_strassen_mpi.cpp
+// Execute: mpirun -np 7 ./matriz_strassen_mpi -n 8192 [-cutoff 512] [-levels 1] [-check]
+//
+// O rank 0 expande os `levels` niveis de cima da recursao em 7^levels produtos
+// independentes (pares de operandos S_i, T_i de Winograd), distribui os produtos
+// em round-robin pelos ranks e, com os resultados de volta, refaz as somas de
+// Winograd para montar C. Cada rank calcula seus produtos com dgemm_strassen
+// (recursao local ate o cutoff, depois o kernel blocado).
+// N e completado com zeros ate s*2^L (s <= cutoff), para que todo nivel seja par.
+// Com -check o rank 0 tambem faz o produto classico e reporta o erro do Strassen,
+// para decidir por job se a perda de precisao compensa o ganho de tempo.
+
+#include <mpi.h>
+#include <cstdint>
+#include <cstdio>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "matriz_kernels.h"
+
+struct Args {
+    int n = 4096;                  // ordem das matrizes
+    int cutoff = 512;              // abaixo disso, algoritmo classico
+    int levels = -1;               // niveis distribuidos (-1 = menor com 7^levels >= P)
+    std::string kernel = "auto";   // kernel do dgemm na base da recursao
+    bool check = false;            // compara com o produto classico no rank 0
+};
+
+Args parse_args(int argc, char** argv) {
+    Args a;
+    for (int i = 1; i < argc; ++i) {
+        std::string s = argv[i];
+        if (s == "-n" && i+1<argc) a.n = std::stoi(argv[++i]);
+        else if (s == "-cutoff" && i+1<argc) a.cutoff = std::max(16, std::stoi(argv[++i]));
+        else if (s == "-levels" && i+1<argc) a.levels = std::stoi(argv[++i]);
+        else if (s == "-kernel" && i+1<argc) a.kernel = argv[++i];
+        else if (s == "-check") a.check = true;
+    }
+    return a;
+}
+
+// Bloco rows x cols de uma matriz row-major com leading dimension ld
+static MPI_Datatype block_type(int rows, int cols, int ld) {
+    MPI_Datatype t;
+    MPI_Type_vector(rows, cols, ld, MPI_DOUBLE, &t);
+    MPI_Type_commit(&t);
+    return t;
+}
+
+// Um produto folha: operandos m x m (ponteiro + leading dimension) no rank 0
+struct Leaf {
+    const double* A; int lda;
+    const double* B; int ldb;
+};
+
+// Passo 1: desce `level` niveis gerando os pares (S_i, T_i) de Winograd na ordem
+// P1..P7. Os temporarios ficam em `temps` ate os envios terminarem.
+static void expand(int level, int n, const double* A, int lda, const double* B, int ldb,
+                   std::vector<Leaf>& leaves, std::vector<double*>& temps) {
+    if (level == 0) { leaves.push_back({A, lda, B, ldb}); return; }
+    int h = n / 2;
+    const double *A11 = A, *A12 = A + h, *A21 = A + (size_t)h * lda, *A22 = A21 + h;
+    const double *B11 = B, *B12 = B + h, *B21 = B + (size_t)h * ldb, *B22 = B21 + h;
+    double* S[4]; double* T[4];
+    for (int i = 0; i < 4; ++i) {
+        S[i] = mk_matrix_alloc(h, h); T[i] = mk_matrix_alloc(h, h);
+        temps.push_back(S[i]); temps.push_back(T[i]);
+    }
+    mk_add(h, h, S[0], h, A21, lda, A22, lda, 1.0);    // S1 = A21 + A22
+    mk_add(h, h, S[1], h, S[0], h, A11, lda, -1.0);    // S2 = S1 - A11
+    mk_add(h, h, S[2], h, A11, lda, A21, lda, -1.0);   // S3 = A11 - A21
+    mk_add(h, h, S[3], h, A12, lda, S[1], h, -1.0);    // S4 = A12 - S2
+    mk_add(h, h, T[0], h, B12, ldb, B11, ldb, -1.0);   // T1 = B12 - B11
+    mk_add(h, h, T[1], h, B22, ldb, T[0], h, -1.0);    // T2 = B22 - T1
+    mk_add(h, h, T[2], h, B22, ldb, B12, ldb, -1.0);   // T3 = B22 - B12
+    mk_add(h, h, T[3], h, T[1], h, B21, ldb, -1.0);    // T4 = T2 - B21
+    expand(level-1, h, A11, lda, B11, ldb, leaves, temps);   // P1 = A11 B11
+    expand(level-1, h, A12, lda, B21, ldb, leaves, temps);   // P2 = A12 B21
+    expand(level-1, h, S[3], h, B22, ldb, leaves, temps);    // P3 = S4 B22
+    expand(level-1, h, A22, lda, T[3], h, leaves, temps);    // P4 = A22 T4
+    expand(level-1, h, S[0], h, T[0], h, leaves, temps);     // P5 = S1 T1
+    expand(level-1, h, S[1], h, T[1], h, leaves, temps);     // P6 = S2 T2
+    expand(level-1, h, S[2], h, T[2], h, leaves, temps);     // P7 = S3 T3
+}
+
+// Passo 2: sobe a mesma arvore consumindo os resultados das folhas na ordem em
+// que foram gerados e monta C com U1..U7.
+static void combine(int level, int n, const std::vector<double*>& res, size_t& idx,
+                    double* C, int ldc) {
+    if (level == 0) {
+        const double* r = res[idx++];
+        for (int i = 0; i < n; ++i)
+            std::copy(r + (size_t)i * n, r + (size_t)(i + 1) * n, C + (size_t)i * ldc);
+        return;
+    }
+    int h = n / 2;
+    double* P[7];
+    for (int i = 0; i < 7; ++i) {
+        P[i] = mk_matrix_alloc(h, h);
+        combine(level-1, h, res, idx, P[i], h);
+    }
+    double *C11 = C, *C12 = C + h, *C21 = C + (size_t)h * ldc, *C22 = C21 + h;
+    mk_add(h, h, C11, ldc, P[0], h, P[1], h, 1.0);     // C11 = U1 = P1 + P2
+    mk_add(h, h, C12, ldc, P[0], h, P[5], h, 1.0);     // U2 = P1 + P6
+    mk_add(h, h, C21, ldc, C12, ldc, P[6], h, 1.0);    // U3 = U2 + P7
+    mk_add(h, h, C12, ldc, C12, ldc, P[4], h, 1.0);    // U4 = U2 + P5
+    mk_add(h, h, C22, ldc, C21, ldc, P[4], h, 1.0);    // C22 = U7 = U3 + P5
+    mk_add(h, h, C12, ldc, C12, ldc, P[2], h, 1.0);    // C12 = U5 = U4 + P3
+    mk_add(h, h, C21, ldc, C21, ldc, P[3], h, -1.0);   // C21 = U6 = U3 - P4
+    for (int i = 0; i < 7; ++i) mk_matrix_free(P[i]);
+}
+
+int main(int argc, char** argv) {
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    int rank = 0, size = 1;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    Args args = parse_args(argc, argv);
+    const int n = args.n;
+
+    // Niveis totais de recursao e tamanho com padding
+    int L = 0, s = n;
+    while (s > args.cutoff) { s = (s + 1) / 2; ++L; }
+    const int np = s << L;
+
+    // Niveis distribuidos: por padrao, o minimo para ter ao menos um produto por rank
+    int d = args.levels;
+    if (d < 0) { d = 0; for (long leaves = 1; leaves < size; leaves *= 7) ++d; }
+    d = std::min(d, L);
+    const int nleaves = (int) std::lround(std::pow(7.0, d));
+    const int m = np >> d;
+
+    dgemm_plan_t plan = dgemm_plan(args.kernel.c_str(), 0, 0, 0);
+    MPI_Datatype rowtype;   // uma linha de um produto folha
+    MPI_Type_contiguous(m, MPI_DOUBLE, &rowtype);
+    MPI_Type_commit(&rowtype);
+
+    if (rank == 0) {
+        std::printf("Strassen-Winograd | N=%d (padding %d) | cutoff=%d | niveis=%d (%d distribuidos)"
+                    " | %d produtos de %d x %d | %d ranks x %d threads | kernel=%s\n",
+                    n, np, args.cutoff, L, d, nleaves, m, m, size, mk_num_threads(), plan.kern->name);
+
+        double* A = mk_matrix_alloc(np, np);
+        double* B = mk_matrix_alloc(np, np);
+        double* C = mk_matrix_alloc(np, np);
+        if (!A || !B || !C) {
+            std::fprintf(stderr, "Sem memoria para 3 matrizes %d x %d\n", np, np);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        // Entradas aleatorias: com valores constantes o produto seria exato e o
+        // erro do Strassen ficaria escondido
+        for (int i = 0; i < np; ++i)
+            for (int j = 0; j < np; ++j) {
+                bool in = i < n && j < n;
+                A[(size_t)i * np + j] = in ? mk_rand_unit((uint64_t)i * n + j, 1) : 0.0;
+                B[(size_t)i * np + j] = in ? mk_rand_unit((uint64_t)i * n + j, 2) : 0.0;
+            }
+
+        double t0 = MPI_Wtime();
+        std::vector<Leaf> leaves;
+        std::vector<double*> temps, res(nleaves);
+        expand(d, np, A, np, B, np, leaves, temps);
+
+        // Envia os operandos dos produtos de outros ranks e ja posta os recebimentos
+        std::vector<MPI_Request> reqs;
+        MPI_Datatype blk_a, blk_b;
+        for (int id = 0; id < nleaves; ++id) {
+            res[id] = mk_matrix_alloc(m, m);
+            int owner = id % size;
+            if (owner == 0) continue;
+            blk_a = block_type(m, m, leaves[id].lda);
+            blk_b = block_type(m, m, leaves[id].ldb);
+            reqs.emplace_back();
+            MPI_Isend(leaves[id].A, 1, blk_a, owner, 2 * id, MPI_COMM_WORLD, &reqs.back());
+            reqs.emplace_back();
+            MPI_Isend(leaves[id].B, 1, blk_b, owner, 2 * id + 1, MPI_COMM_WORLD, &reqs.back());
+            reqs.emplace_back();
+            MPI_Irecv(res[id], m, rowtype, owner, id, MPI_COMM_WORLD, &reqs.back());
+            MPI_Type_free(&blk_a);
+            MPI_Type_free(&blk_b);
+        }
+        for (int id = 0; id < nleaves; id += size) {
+            dgemm_strassen(&plan, m, leaves[id].A, leaves[id].lda, leaves[id].B, leaves[id].ldb,
+                           res[id], m, args.cutoff);
+            int done;
+            MPI_Testall((int) reqs.size(), reqs.data(), &done, MPI_STATUSES_IGNORE);
+        }
+        MPI_Waitall((int) reqs.size(), reqs.data(), MPI_STATUSES_IGNORE);
+        for (double* t : temps) mk_matrix_free(t);
+
+        size_t idx = 0;
+        combine(d, np, res, idx, C, np);
+        double t_strassen = MPI_Wtime() - t0;
+        for (double* r : res) mk_matrix_free(r);
+
+        std::printf("Strassen: %.3f s | %.2f GFLOPS efetivos (2N^3/t)\n",
+                    t_strassen, 2.0 * n * (double) n * n / t_strassen / 1e9);
+
+        if (args.check) {
+            double* R = mk_matrix_alloc(n, n);
+            double t1 = MPI_Wtime();
+            dgemm_blocked(&plan, n, n, n, A, np, B, np, 0, R, n);
+            double t_classic = MPI_Wtime() - t1;
+            double maxdiff = 0.0, maxref = 0.0;
+            for (int i = 0; i < n; ++i)
+                for (int j = 0; j < n; ++j) {
+                    double r = R[(size_t)i * n + j];
+                    maxdiff = std::max(maxdiff, std::fabs(C[(size_t)i * np + j] - r));
+                    maxref = std::max(maxref, std::fabs(r));
+                }
+            std::printf("Classico (rank 0): %.3f s | %.2f GFLOPS\n",
+                        t_classic, 2.0 * n * (double) n * n / t_classic / 1e9);
+            std::printf("Erro vs classico: max |diff| = %.3e | relativo ao max |C| = %.3e\n",
+                        maxdiff, maxref > 0 ? maxdiff / maxref : 0.0);
+            mk_matrix_free(R);
+        }
+        mk_matrix_free(A);
+        mk_matrix_free(B);
+        mk_matrix_free(C);
+    } else {
+        // Produtos deste rank: recebe todos os operandos de uma vez e devolve cada
+        // resultado assim que fica pronto
+        std::vector<int> mine;
+        for (int id = rank; id < nleaves; id += size) mine.push_back(id);
+        size_t k = mine.size();
+        std::vector<double*> sa(k), tb(k), pr(k);
+        std::vector<MPI_Request> rreq(2 * k), sreq(k);
+        for (size_t i = 0; i < k; ++i) {
+            sa[i] = mk_matrix_alloc(m, m);
+            tb[i] = mk_matrix_alloc(m, m);
+            pr[i] = mk_matrix_alloc(m, m);
+            if (!sa[i] || !tb[i] || !pr[i]) {
+                std::fprintf(stderr, "Rank %d: sem memoria para o produto %d\n", rank, mine[i]);
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            MPI_Irecv(sa[i], m, rowtype, 0, 2 * mine[i], MPI_COMM_WORLD, &rreq[2 * i]);
+            MPI_Irecv(tb[i], m, rowtype, 0, 2 * mine[i] + 1, MPI_COMM_WORLD, &rreq[2 * i + 1]);
+        }
+        for (size_t i = 0; i < k; ++i) {
+            MPI_Waitall(2, &rreq[2 * i], MPI_STATUSES_IGNORE);
+            dgemm_strassen(&plan, m, sa[i], m, tb[i], m, pr[i], m, args.cutoff);
+            MPI_Isend(pr[i], m, rowtype, 0, mine[i], MPI_COMM_WORLD, &sreq[i]);
+        }
+        MPI_Waitall((int) k, sreq.data(), MPI_STATUSES_IGNORE);
+        for (size_t i = 0; i < k; ++i) {
+            mk_matrix_free(sa[i]);
+            mk_matrix_free(tb[i]);
+            mk_matrix_free(pr[i]);
+        }
+    }
+
+    MPI_Type_free(&rowtype);
+    MPI_Finalize();
+    return 0;
+}
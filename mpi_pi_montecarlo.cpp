@@ -1,6 +1,49 @@
 // mpi_pi_montecarlo.cpp
 // Calculo de Pi por Monte Carlo com MPI (master/worker) + OpenMP opcional
 // Compile: mpicxx -O3 -std=c++17 -fopenmp -o mpi_pi_montecarlo mpi_pi_montecarlo.cpp
+//
+// Modos de amostragem (-mode):
+//   prng : pseudo-aleatorio (mt19937_64), erro ~ O(1/sqrt(N))
+//   qmc  : quasi-Monte Carlo, Sobol 2D com embaralhamento de Owen, erro ~ O(log N / N)
+// Com -replicas R > 1 o orcamento de amostras e dividido em R replicas independentes
+// (sementes/embaralhamentos distintos) e o master reporta media e erro padrao.
+//
+// Kernels do modo prng (-kernel, padrao auto = melhor suportado pela CPU):
+//   ref    : mt19937_64 + uniform_real_distribution + if (referencia original)
+//   scalar : xoshiro256++, coordenadas em ponto fixo de 32 bits, sem desvio
+//   fp     : xoshiro256++, coordenadas double via bits de mantissa, sem desvio
+//   avx2   : 4 fluxos xoshiro256++ em paralelo, teste inteiro + movemask/popcount
+//   avx512 : 8 fluxos xoshiro256++ em paralelo, teste inteiro + mascara/popcount
+// -kernelbench mede amostras/s por core de cada kernel disponivel e encerra.
+//
+// Reducao de variancia do modo prng (-vr), no quarto de circulo [0,1]^2:
+//   none       : estimador simples (usa os kernels acima)
+//   antithetic : pares (u,v) e (1-u,1-v); a indicadora e monotona, logo correlacao negativa
+//   stratified : grade -strata G x G celulas com o mesmo numero de pontos; as tarefas
+//                recebem celulas inteiras
+//   control    : variavel de controle g = u^2 + v^2 (E[g] = 2/3), coeficiente otimo
+//                estimado a partir das proprias amostras
+// O master reporta a variancia por amostra e o fator de reducao em relacao ao
+// estimador simples com o mesmo numero de pontos.
+//
+// Tolerancia a falhas (-timeout T segundos, 0 = desligado): o master guarda a
+// tarefa em andamento de cada worker com um prazo; ao estourar, o worker fica
+// suspeito e a tarefa e reemitida para outro. Resultados repetidos sao
+// descartados pelo task_id. Sem workers disponiveis o master calcula sozinho.
+// No fim, workers ainda suspeitos apos -grace segundos encerram o job com
+// MPI_Abort (o resultado ja foi impresso); com ULFM (MPIX_*) ranks mortos sao
+// detectados na hora e o comunicador e encolhido antes do MPI_Finalize.
+// Sem prazo o master fica bloqueado em MPI_Wait (nao gasta CPU); com prazo ele
+// testa a recepcao e dorme entre os testes, no maximo ate o prazo mais proximo.
+// Compilado com -DMC_TEST_HOOKS, -stall R faz o rank R segurar o primeiro
+// resultado (para exercitar a reemissao).
+//
+// Benchmark de escalabilidade (-bench): varre -bench_batches e -bench_threads
+// (listas separadas por virgula) e, dentro do mesmo job, 1, 2, 4, ... workers.
+// Escala forte usa -samples fixo; escala fraca usa -samples/max_workers por
+// worker. Mede amostras/s por rank, latencia de despacho (resultado enviado ->
+// proxima tarefa recebida, vista pelo worker) e fracao de tempo ocioso, e
+// grava CSV (stdout ou <prefixo>.csv) e JSON (<prefixo>.json com -bench_out).
 
 #include <mpi.h>
 #include <cstdint>
@@ -10,19 +53,89 @@
 #include <string>
 #include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <thread>
+#include <fstream>
+#include <sstream>
 
 #ifdef _OPENMP
 #include <omp.h>
 #endif
 
+#if __has_include(<mpi-ext.h>)
+#include <mpi-ext.h>
+#endif
+#if defined(MPIX_ERR_PROC_FAILED)
+#define HAVE_ULFM 1
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
 enum Tags { TAG_TASK = 1, TAG_RESULT = 2, TAG_STOP = 3 };
+enum Mode { MODE_PRNG = 0, MODE_QMC = 1 };
+enum VarianceReduction { VR_NONE = 0, VR_ANTITHETIC, VR_STRATIFIED, VR_CONTROL, VR_COUNT };
+enum Kernel { KERNEL_AUTO = -1, KERNEL_REF = 0, KERNEL_SCALAR, KERNEL_FP, KERNEL_AVX2, KERNEL_AVX512, KERNEL_COUNT };
+
+static const char* kernel_names[KERNEL_COUNT] = { "ref", "scalar", "fp", "avx2", "avx512" };
+static const char* vr_names[VR_COUNT] = { "none", "antithetic", "stratified", "control" };
 
 struct Args {
     uint64_t samples_total = 1000000ULL; // 1e6
     uint64_t batch = 1000000ULL;         // 1e6 por tarefa
     int report_every = 10;                // imprime parcial a cada N tarefas
+    int mode = MODE_PRNG;                 // prng | qmc
+    uint64_t replicas = 1;                // replicas independentes (barras de erro)
+    uint64_t seed = 0xA5A5A5A55A5A5A5AULL;
+    int kernel = KERNEL_AUTO;
+    bool kernel_bench = false;
+    int vr = VR_NONE;
+    uint64_t strata = 64;                 // celulas por eixo no modo stratified
+    double timeout = 0.0;                 // prazo por tarefa em segundos (0 = sem prazo)
+    double grace = 5.0;                   // espera final por workers suspeitos
+#ifdef MC_TEST_HOOKS
+    int stall_rank = -1;                  // teste: rank que trava na primeira tarefa
+#endif
+    bool bench = false;                   // benchmark de escalabilidade
+    std::vector<uint64_t> bench_batches;
+    std::vector<int> bench_threads;
+    std::string bench_out;                // prefixo dos arquivos .csv/.json
 };
 
+template <typename T>
+static std::vector<T> parse_list(const std::string& s) {
+    std::vector<T> out;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ','))
+        if (!item.empty()) out.push_back((T) std::stod(item)); // aceita 1e6
+    return out;
+}
+
+// Ajusta batch/replicas ao total de amostras
+static void normalize_args(Args& a) {
+    if (a.replicas > a.samples_total) a.replicas = std::max<uint64_t>(1ULL, a.samples_total);
+    uint64_t per_replica = a.samples_total / a.replicas;
+    if (a.batch == 0) a.batch = 1000000ULL;
+    if (a.batch > per_replica) a.batch = per_replica;
+}
+
+static int kernel_from_name(const std::string& name) {
+    for (int k = 0; k < KERNEL_COUNT; ++k)
+        if (name == kernel_names[k]) return k;
+    return KERNEL_AUTO;
+}
+
+static int vr_from_name(const std::string& name) {
+    for (int v = 0; v < VR_COUNT; ++v)
+        if (name == vr_names[v]) return v;
+    return VR_NONE;
+}
+
 Args parse_args(int argc, char** argv) {
     Args a;
     for (int i=1;i<argc;++i) {
@@ -30,74 +143,620 @@ Args parse_args(int argc, char** argv) {
         if (s=="-samples" && i+1<argc) a.samples_total = std::stoull(argv[++i]);
         else if (s=="-batch" && i+1<argc) a.batch = std::stoull(argv[++i]);
         else if (s=="-report" && i+1<argc) a.report_every = std::max(1, std::stoi(argv[++i]));
+        else if (s=="-mode" && i+1<argc) a.mode = (std::string(argv[++i]) == "qmc") ? MODE_QMC : MODE_PRNG;
+        else if (s=="-replicas" && i+1<argc) a.replicas = std::max<uint64_t>(1ULL, std::stoull(argv[++i]));
+        else if (s=="-seed" && i+1<argc) a.seed = std::stoull(argv[++i]);
+        else if (s=="-kernel" && i+1<argc) a.kernel = kernel_from_name(argv[++i]);
+        else if (s=="-kernelbench") a.kernel_bench = true;
+        else if (s=="-vr" && i+1<argc) a.vr = vr_from_name(argv[++i]);
+        else if (s=="-strata" && i+1<argc) a.strata = std::max<uint64_t>(1ULL, std::stoull(argv[++i]));
+        else if (s=="-timeout" && i+1<argc) a.timeout = std::max(0.0, std::stod(argv[++i]));
+        else if (s=="-grace" && i+1<argc) a.grace = std::max(0.0, std::stod(argv[++i]));
+#ifdef MC_TEST_HOOKS
+        else if (s=="-stall" && i+1<argc) a.stall_rank = std::stoi(argv[++i]);
+#endif
+        else if (s=="-bench") a.bench = true;
+        else if (s=="-bench_batches" && i+1<argc) a.bench_batches = parse_list<uint64_t>(argv[++i]);
+        else if (s=="-bench_threads" && i+1<argc) a.bench_threads = parse_list<int>(argv[++i]);
+        else if (s=="-bench_out" && i+1<argc) a.bench_out = argv[++i];
     }
-    if (a.batch == 0) a.batch = 1000000ULL;
-    if (a.batch > a.samples_total) a.batch = a.samples_total;
+    if (a.mode == MODE_QMC) a.vr = VR_NONE;
+    normalize_args(a);
     return a;
 }
 
+// Tarefa = faixa [start, start+n) de indices de amostra dentro de uma replica.
+// Derivada apenas do task_id, entao master e workers nao precisam trocar a tabela.
+// No modo stratified a amostra 'i' pertence a celula i / cell_samples e as
+// faixas sao alinhadas a celulas inteiras.
+struct Task {
+    uint64_t id;
+    uint64_t replica;
+    uint64_t start;
+    uint64_t n;
+};
+
+struct TaskLayout {
+    uint64_t per_replica;       // amostras por replica
+    uint64_t batch;
+    uint64_t tasks_per_replica;
+    uint64_t tasks;
+    uint64_t cell_samples;      // pontos por celula (stratified), 0 caso contrario
+
+    TaskLayout(const Args& a) {
+        per_replica = a.samples_total / a.replicas;
+        batch = a.batch;
+        cell_samples = 0;
+        if (a.vr == VR_STRATIFIED) {
+            // pelo menos 2 pontos por celula para estimar a variancia interna
+            uint64_t cells = a.strata * a.strata;
+            cell_samples = std::max<uint64_t>(2ULL, per_replica / cells);
+            per_replica = cell_samples * cells;
+            batch = std::max<uint64_t>(1ULL, batch / cell_samples) * cell_samples;
+            if (batch > per_replica) batch = per_replica;
+        }
+        tasks_per_replica = (per_replica + batch - 1) / batch;
+        tasks = tasks_per_replica * a.replicas;
+    }
+
+    Task make(uint64_t id) const {
+        Task t;
+        t.id = id;
+        t.replica = id / tasks_per_replica;
+        t.start = (id % tasks_per_replica) * batch;
+        t.n = std::min(batch, per_replica - t.start);
+        return t;
+    }
+};
+
+static inline uint64_t mix64(uint64_t z) {
+    // splitmix64: deriva sementes independentes a partir de contadores
+    z += 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// ---------------------------------------------------------------------------
+// Kernels do teste no circulo
+// ---------------------------------------------------------------------------
+// Todos recebem 'n' e uma semente e devolvem quantos pontos caem no circulo.
+// Os kernels rapidos usam xoshiro256++ (so soma/xor/shift/rotacao, portanto
+// vetorizavel sem multiplicacao de 64 bits) e cada palavra de 64 bits vira um
+// ponto: metade alta = x, metade baixa = y, ambos inteiros com sinal de 32 bits
+// em [-2^31, 2^31). O ponto esta no circulo se x^2 + y^2 <= 2^62, conta feita
+// exatamente em inteiros de 64 bits.
+
+static const uint64_t R2_FIXED = 1ULL << 62;
+
+static inline uint64_t rotl64(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+struct Xoshiro256pp {
+    uint64_t s[4];
+
+    explicit Xoshiro256pp(uint64_t seed) {
+        for (int k = 0; k < 4; ++k) { seed = mix64(seed); s[k] = seed; }
+    }
+
+    inline uint64_t next() {
+        uint64_t r = rotl64(s[0] + s[3], 23) + s[0];
+        uint64_t t = s[1] << 17;
+        s[2] ^= s[0]; s[3] ^= s[1]; s[1] ^= s[2]; s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl64(s[3], 45);
+        return r;
+    }
+};
+
+// ref: laco original (distribuicao + desvio), mantido como referencia
+static uint64_t count_ref(uint64_t n, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    uint64_t local = 0ULL;
+    for (uint64_t i=0; i<n; ++i) {
+        double x = dist(rng);
+        double y = dist(rng);
+        if (x*x + y*y <= 1.0) ++local;
+    }
+    return local;
+}
+
+// scalar: ponto fixo de 32 bits, comparacao convertida em soma (sem desvio)
+static uint64_t count_scalar(uint64_t n, uint64_t seed) {
+    Xoshiro256pp rng(seed);
+    uint64_t local = 0ULL;
+    for (uint64_t i=0; i<n; ++i) {
+        uint64_t w = rng.next();
+        int64_t x = (int32_t)(uint32_t)(w >> 32);
+        int64_t y = (int32_t)(uint32_t)w;
+        uint64_t d = (uint64_t)(x*x) + (uint64_t)(y*y);
+        local += (d <= R2_FIXED);
+    }
+    return local;
+}
+
+// fp: 32 bits aleatorios na mantissa de um double em [1,2), depois [-1,1)
+static uint64_t count_fp(uint64_t n, uint64_t seed) {
+    Xoshiro256pp rng(seed);
+    uint64_t local = 0ULL;
+    for (uint64_t i=0; i<n; ++i) {
+        uint64_t w = rng.next();
+        uint64_t bx = 0x3FF0000000000000ULL | ((w >> 32) << 20);
+        uint64_t by = 0x3FF0000000000000ULL | ((w & 0xFFFFFFFFULL) << 20);
+        double x, y;
+        std::memcpy(&x, &bx, sizeof x);
+        std::memcpy(&y, &by, sizeof y);
+        x = 2.0 * x - 3.0;
+        y = 2.0 * y - 3.0;
+        local += (x*x + y*y <= 1.0);
+    }
+    return local;
+}
+
+#ifdef HAVE_X86_SIMD
+// Estado de L fluxos xoshiro256++ independentes, intercalado por componente
+// (s[k][lane]) para carregar direto em registradores SIMD.
+template <int L>
+static void seed_lanes(uint64_t seed, uint64_t (&st)[4][L]) {
+    for (int lane = 0; lane < L; ++lane) {
+        Xoshiro256pp g(seed ^ mix64((uint64_t)lane + 1));
+        for (int k = 0; k < 4; ++k) st[k][lane] = g.s[k];
+    }
+}
+
+__attribute__((target("avx2")))
+static inline __m256i rotl_avx2(__m256i x, int k) {
+    return _mm256_or_si256(_mm256_slli_epi64(x, k), _mm256_srli_epi64(x, 64 - k));
+}
+
+__attribute__((target("avx2,popcnt")))
+static uint64_t count_avx2(uint64_t n, uint64_t seed) {
+    alignas(32) uint64_t st[4][4];
+    seed_lanes<4>(seed, st);
+    __m256i s0 = _mm256_load_si256((const __m256i*) st[0]);
+    __m256i s1 = _mm256_load_si256((const __m256i*) st[1]);
+    __m256i s2 = _mm256_load_si256((const __m256i*) st[2]);
+    __m256i s3 = _mm256_load_si256((const __m256i*) st[3]);
+    // x^2 + y^2 - (2^62 + 1) < 0  <=>  acerto; o bit de sinal e a mascara
+    const __m256i lim = _mm256_set1_epi64x((long long)(R2_FIXED + 1));
+
+    uint64_t hits = 0ULL;
+    uint64_t blocks = n / 4;
+    for (uint64_t b = 0; b < blocks; ++b) {
+        __m256i r = _mm256_add_epi64(rotl_avx2(_mm256_add_epi64(s0, s3), 23), s0);
+        __m256i t = _mm256_slli_epi64(s1, 17);
+        s2 = _mm256_xor_si256(s2, s0);
+        s3 = _mm256_xor_si256(s3, s1);
+        s1 = _mm256_xor_si256(s1, s2);
+        s0 = _mm256_xor_si256(s0, s3);
+        s2 = _mm256_xor_si256(s2, t);
+        s3 = rotl_avx2(s3, 45);
+
+        // _mm256_mul_epi32 usa os 32 bits baixos (com sinal) de cada lane de 64
+        __m256i x = _mm256_srli_epi64(r, 32);
+        __m256i d = _mm256_add_epi64(_mm256_mul_epi32(x, x), _mm256_mul_epi32(r, r));
+        d = _mm256_sub_epi64(d, lim);
+        hits += (uint64_t) _mm_popcnt_u32((unsigned) _mm256_movemask_pd(_mm256_castsi256_pd(d)));
+    }
+    return hits + count_scalar(n - blocks * 4, mix64(seed ^ 0x243F6A8885A308D3ULL));
+}
+
+__attribute__((target("avx512f,popcnt")))
+static uint64_t count_avx512(uint64_t n, uint64_t seed) {
+    alignas(64) uint64_t st[4][8];
+    seed_lanes<8>(seed, st);
+    __m512i s0 = _mm512_load_si512((const void*) st[0]);
+    __m512i s1 = _mm512_load_si512((const void*) st[1]);
+    __m512i s2 = _mm512_load_si512((const void*) st[2]);
+    __m512i s3 = _mm512_load_si512((const void*) st[3]);
+    const __m512i lim = _mm512_set1_epi64((long long) R2_FIXED);
+
+    uint64_t hits = 0ULL;
+    uint64_t blocks = n / 8;
+    for (uint64_t b = 0; b < blocks; ++b) {
+        __m512i r = _mm512_add_epi64(_mm512_rol_epi64(_mm512_add_epi64(s0, s3), 23), s0);
+        __m512i t = _mm512_slli_epi64(s1, 17);
+        s2 = _mm512_xor_si512(s2, s0);
+        s3 = _mm512_xor_si512(s3, s1);
+        s1 = _mm512_xor_si512(s1, s2);
+        s0 = _mm512_xor_si512(s0, s3);
+        s2 = _mm512_xor_si512(s2, t);
+        s3 = _mm512_rol_epi64(s3, 45);
+
+        __m512i x = _mm512_srli_epi64(r, 32);
+        __m512i d = _mm512_add_epi64(_mm512_mul_epi32(x, x), _mm512_mul_epi32(r, r));
+        __mmask8 m = _mm512_cmple_epu64_mask(d, lim);
+        hits += (uint64_t) _mm_popcnt_u32((unsigned) m);
+    }
+    return hits + count_scalar(n - blocks * 8, mix64(seed ^ 0x243F6A8885A308D3ULL));
+}
+#endif
+
+static bool kernel_supported(int k) {
+    switch (k) {
+    case KERNEL_REF: case KERNEL_SCALAR: case KERNEL_FP: return true;
+#ifdef HAVE_X86_SIMD
+    case KERNEL_AVX2: return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+    case KERNEL_AVX512: return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("popcnt");
+#endif
+    default: return false;
+    }
+}
+
+// Escolhe o kernel pedido, ou o melhor suportado quando 'auto'/indisponivel
+static int resolve_kernel(int requested) {
+    if (requested != KERNEL_AUTO && kernel_supported(requested)) return requested;
+    for (int k = KERNEL_COUNT - 1; k > KERNEL_REF; --k)
+        if (kernel_supported(k)) return k;
+    return KERNEL_SCALAR;
+}
+
+static inline uint64_t count_kernel(int kernel, uint64_t n, uint64_t seed) {
+    switch (kernel) {
+    case KERNEL_REF: return count_ref(n, seed);
+    case KERNEL_FP: return count_fp(n, seed);
+#ifdef HAVE_X86_SIMD
+    case KERNEL_AVX2: return count_avx2(n, seed);
+    case KERNEL_AVX512: return count_avx512(n, seed);
+#endif
+    default: return count_scalar(n, seed);
+    }
+}
+
 // Gera 'n' pontos uniformes em [-1,1]x[-1,1] e retorna quantos caem no círculo de raio 1
-static inline uint64_t hits_in_circle(uint64_t n, uint64_t seed_base) {
+static inline uint64_t hits_in_circle(uint64_t n, uint64_t seed_base, int kernel) {
     uint64_t hits = 0ULL;
 
 #ifdef _OPENMP
     int max_threads = omp_get_max_threads();
     #pragma omp parallel reduction(+:hits)
     {
-        int tid = 0;
-        #ifdef _OPENMP
-        tid = omp_get_thread_num();
-        #endif
+        int tid = omp_get_thread_num();
         // semente por thread para independência dos fluxos
-        std::mt19937_64 rng(seed_base ^ (0x9E3779B97F4A7C15ULL * (tid+1)));
-        std::uniform_real_distribution<double> dist(-1.0, 1.0);
+        uint64_t seed = seed_base ^ (0x9E3779B97F4A7C15ULL * (uint64_t)(tid+1));
 
         // dividir n entre as threads (quase) igualmente
         uint64_t base = n / max_threads;
         uint64_t extra = n % max_threads;
-        uint64_t my_n = base + (uint64_t)(tid < extra ? 1 : 0);
+        uint64_t my_n = base + (uint64_t)((uint64_t)tid < extra ? 1 : 0);
 
-        uint64_t local = 0ULL;
-        for (uint64_t i=0; i<my_n; ++i) {
-            double x = dist(rng);
-            double y = dist(rng);
-            if (x*x + y*y <= 1.0) ++local;
-        }
-        hits += local;
+        hits += count_kernel(kernel, my_n, seed);
     }
 #else
-    std::mt19937_64 rng(seed_base);
-    std::uniform_real_distribution<double> dist(-1.0, 1.0);
-    for (uint64_t i=0; i<n; ++i) {
-        double x = dist(rng);
-        double y = dist(rng);
-        if (x*x + y*y <= 1.0) ++hits;
+    hits = count_kernel(kernel, n, seed_base);
+#endif
+
+    return hits;
+}
+
+// Micro-benchmark: amostras/s de cada kernel suportado em uma unica thread.
+// Cada rank mede o seu core; o master reporta media, minimo e maximo.
+static void run_kernel_bench(int rank, int size, uint64_t n, uint64_t seed) {
+    const int MASTER = 0;
+    if (rank == MASTER)
+        std::cout << "Kernel benchmark | samples/core=" << n << " | ranks=" << size << "\n"
+                  << "kernel,samples_per_s_avg,samples_per_s_min,samples_per_s_max,pi\n";
+    for (int k = 0; k < KERNEL_COUNT; ++k) {
+        int ok = kernel_supported(k) ? 1 : 0;
+        int all_ok = 0;
+        MPI_Allreduce(&ok, &all_ok, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+        if (!all_ok) {
+            if (rank == MASTER) std::cout << kernel_names[k] << ",nao suportado\n";
+            continue;
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        auto c0 = std::chrono::steady_clock::now();
+        uint64_t h = count_kernel(k, n, seed ^ (uint64_t)rank);
+        auto c1 = std::chrono::steady_clock::now();
+        double rate = (double) n / std::chrono::duration<double>(c1 - c0).count();
+
+        double sum = 0.0, mn = 0.0, mx = 0.0;
+        MPI_Reduce(&rate, &sum, 1, MPI_DOUBLE, MPI_SUM, MASTER, MPI_COMM_WORLD);
+        MPI_Reduce(&rate, &mn, 1, MPI_DOUBLE, MPI_MIN, MASTER, MPI_COMM_WORLD);
+        MPI_Reduce(&rate, &mx, 1, MPI_DOUBLE, MPI_MAX, MASTER, MPI_COMM_WORLD);
+        if (rank == MASTER)
+            std::cout << kernel_names[k] << "," << sum / size << "," << mn << "," << mx
+                      << "," << 4.0 * (double) h / (double) n << "\n";
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Sobol 2D (32 bits) com embaralhamento de Owen
+// ---------------------------------------------------------------------------
+// Dimensao 0: van der Corput base 2. Dimensao 1: polinomio primitivo x+1.
+// A ordem de Gray permite gerar o ponto i+1 a partir do ponto i com um XOR,
+// e o ponto inicial de qualquer faixa e calculado diretamente do indice, entao
+// cada tarefa/thread percorre sua faixa de indices sem coordenacao.
+struct Sobol2D {
+    uint32_t v[2][32];
+
+    Sobol2D() {
+        for (int k = 0; k < 32; ++k) v[0][k] = 1u << (31 - k);
+        v[1][0] = 1u << 31;
+        for (int k = 1; k < 32; ++k) v[1][k] = v[1][k-1] ^ (v[1][k-1] >> 1);
+    }
+
+    // ponto de indice 'i' na ordem de Gray
+    void point(uint32_t i, uint32_t& x, uint32_t& y) const {
+        uint32_t g = i ^ (i >> 1);
+        x = y = 0u;
+        for (int k = 0; g; ++k, g >>= 1) {
+            if (g & 1u) { x ^= v[0][k]; y ^= v[1][k]; }
+        }
+    }
+
+    // avanca do ponto 'i' para 'i+1'
+    void next(uint32_t i, uint32_t& x, uint32_t& y) const {
+        int k = __builtin_ctz(i + 1u);
+        x ^= v[0][k];
+        y ^= v[1][k];
+    }
+};
+
+static inline uint32_t reverse_bits32(uint32_t x) {
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+    x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+// Embaralhamento de Owen (nested uniform) via hash de Laine-Karras (Burley 2020):
+// cada bit e invertido em funcao apenas dos bits mais significativos.
+static inline uint32_t owen_scramble(uint32_t x, uint32_t seed) {
+    x = reverse_bits32(x);
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return reverse_bits32(x);
+}
+
+static inline uint64_t qmc_count(const Sobol2D& s, uint64_t start, uint64_t n,
+                                 uint32_t seed_x, uint32_t seed_y) {
+    // mapeia [0,2^32) -> [-1,1) pelo centro da celula: u = (k + 0.5) / 2^31 - 1
+    const double scale = 1.0 / 2147483648.0;
+    uint64_t local = 0ULL;
+    if (n == 0) return 0ULL;
+    uint32_t i = (uint32_t) start;
+    uint32_t ix, iy;
+    s.point(i, ix, iy);
+    for (uint64_t c = 0; c < n; ++c) {
+        double x = ((double) owen_scramble(ix, seed_x) + 0.5) * scale - 1.0;
+        double y = ((double) owen_scramble(iy, seed_y) + 0.5) * scale - 1.0;
+        if (x*x + y*y <= 1.0) ++local;
+        if (c + 1 < n) { s.next(i, ix, iy); ++i; }
+    }
+    return local;
+}
+
+// Versao QMC: conta acertos para os indices Sobol [start, start+n) da replica
+// embaralhada por 'seed_base'. Threads dividem a faixa de indices.
+static inline uint64_t hits_in_circle_qmc(uint64_t start, uint64_t n, uint64_t seed_base) {
+    static const Sobol2D sobol;
+    uint32_t seed_x = (uint32_t) mix64(seed_base);
+    uint32_t seed_y = (uint32_t) mix64(seed_base ^ 0xD1B54A32D192ED03ULL);
+    uint64_t hits = 0ULL;
+
+#ifdef _OPENMP
+    int max_threads = omp_get_max_threads();
+    #pragma omp parallel reduction(+:hits)
+    {
+        int tid = omp_get_thread_num();
+        uint64_t base = n / max_threads;
+        uint64_t extra = n % max_threads;
+        uint64_t my_n = base + (uint64_t)((uint64_t)tid < extra ? 1 : 0);
+        uint64_t my_start = start + base * (uint64_t)tid + std::min<uint64_t>((uint64_t)tid, extra);
+        hits += qmc_count(sobol, my_start, my_n, seed_x, seed_y);
     }
+#else
+    hits = qmc_count(sobol, start, n, seed_x, seed_y);
 #endif
 
     return hits;
 }
 
-int main(int argc, char** argv) {
-    MPI_Init(&argc, &argv);
-    int rank=0, size=1;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    MPI_Comm_size(MPI_COMM_WORLD, &size);
+// ---------------------------------------------------------------------------
+// Reducao de variancia
+// ---------------------------------------------------------------------------
+// Accum guarda somas suficientes para combinar tarefas em qualquer ordem:
+//   none/antithetic : s[0]=sum Y, s[1]=sum Y^2            (unidade = ponto / par)
+//   control         : s[0..4] = sum Y, Y^2, g, g^2, Y*g   (unidade = ponto)
+//   stratified      : s[0]=sum p_c, s[1]=sum Var(p_c)     (unidade = celula)
+// onde Y e a estimativa de pi de uma unidade.
+struct Accum {
+    uint64_t samples = 0;  // pontos avaliados
+    uint64_t units = 0;
+    double s[5] = { 0.0, 0.0, 0.0, 0.0, 0.0 };
 
-    const int MASTER = 0;
-    Args args = parse_args(argc, argv);
+    void add(const Accum& o) {
+        samples += o.samples;
+        units += o.units;
+        for (int k = 0; k < 5; ++k) s[k] += o.s[k];
+    }
+};
+
+// Mensagem de resultado worker -> master (cluster homogeneo, enviada como bytes)
+struct Result {
+    uint64_t task_id;
+    Accum acc;
+};
+
+static const double CONTROL_MEAN = 2.0 / 3.0; // E[u^2 + v^2] em [0,1]^2
 
-    // Timer global
-    double t0 = 0, t1 = 0;
-    if (rank == MASTER) t0 = MPI_Wtime();
+static inline double u01(uint64_t w) { return (double)(w >> 11) * (1.0 / 9007199254740992.0); }
 
-    // MASTER: cria fila de tarefas (cada tarefa = 'batch' amostras)
-    if (rank == MASTER) {
-        // Quantidade de tarefas e possível resto
-        uint64_t tasks = args.samples_total / args.batch;
-        uint64_t remainder = args.samples_total % args.batch;
-        if (remainder > 0) ++tasks; // última tarefa tem menos pontos
+// Contagem simples convertida em somas (Y = 4 * indicadora, Y^2 = 16 * indicadora)
+static inline Accum accum_from_hits(uint64_t hits, uint64_t n) {
+    Accum a;
+    a.samples = a.units = n;
+    a.s[0] = 4.0 * (double) hits;
+    a.s[1] = 16.0 * (double) hits;
+    return a;
+}
+
+static Accum vr_eval(int vr, const Task& t, uint64_t cell_samples, uint64_t strata, uint64_t seed_base) {
+    Accum total;
+    uint64_t units = (vr == VR_STRATIFIED) ? t.n / cell_samples
+                   : (vr == VR_ANTITHETIC) ? t.n / 2 : t.n;
+    uint64_t first_cell = (vr == VR_STRATIFIED) ? t.start / cell_samples : 0;
+    double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0, s4 = 0.0;
+
+    #pragma omp parallel reduction(+:s0,s1,s2,s3,s4)
+    {
+        int tid = 0;
+#ifdef _OPENMP
+        tid = omp_get_thread_num();
+#endif
+        Xoshiro256pp rng(seed_base ^ (0x9E3779B97F4A7C15ULL * (uint64_t)(tid+1)));
+
+        #pragma omp for schedule(static)
+        for (uint64_t i = 0; i < units; ++i) {
+            if (vr == VR_ANTITHETIC) {
+                double u = u01(rng.next()), v = u01(rng.next());
+                double u2 = 1.0 - u, v2 = 1.0 - v;
+                double y = 2.0 * ((u*u + v*v <= 1.0) + (u2*u2 + v2*v2 <= 1.0));
+                s0 += y; s1 += y * y;
+            } else if (vr == VR_CONTROL) {
+                double u = u01(rng.next()), v = u01(rng.next());
+                double g = u*u + v*v;
+                double y = 4.0 * (g <= 1.0);
+                s0 += y; s1 += y * y; s2 += g; s3 += g * g; s4 += y * g;
+            } else if (vr == VR_STRATIFIED) {
+                uint64_t cell = first_cell + i;
+                double cx = (double)(cell % strata), cy = (double)(cell / strata);
+                double inv = 1.0 / (double) strata;
+                uint64_t k = 0;
+                for (uint64_t j = 0; j < cell_samples; ++j) {
+                    double u = (cx + u01(rng.next())) * inv;
+                    double v = (cy + u01(rng.next())) * inv;
+                    k += (u*u + v*v <= 1.0);
+                }
+                double m = (double) cell_samples;
+                double p = (double) k / m;
+                s0 += p;
+                s1 += p * (1.0 - p) / (m - 1.0); // Var(p_c) com variancia amostral
+            }
+        }
+    }
+
+    total.units = units;
+    total.samples = (vr == VR_STRATIFIED) ? units * cell_samples
+                  : (vr == VR_ANTITHETIC) ? 2 * units : units;
+    total.s[0] = s0; total.s[1] = s1; total.s[2] = s2; total.s[3] = s3; total.s[4] = s4;
+    return total;
+}
+
+// Estimativa de pi e variancia da estimativa a partir das somas acumuladas.
+static void vr_estimate(int vr, const Accum& a, double& est, double& var_est) {
+    double u = (double) a.units;
+    est = var_est = 0.0;
+    if (a.units == 0) return;
+    if (vr == VR_STRATIFIED) {
+        // celulas de mesma area: media simples das proporcoes
+        est = 4.0 * a.s[0] / u;
+        var_est = 16.0 * a.s[1] / (u * u);
+        return;
+    }
+    double my = a.s[0] / u;
+    double vyy = (a.s[1] - u * my * my) / std::max(1.0, u - 1.0);
+    if (vr == VR_CONTROL) {
+        double mg = a.s[2] / u;
+        double vgg = (a.s[3] - u * mg * mg) / std::max(1.0, u - 1.0);
+        double cyg = (a.s[4] - u * my * mg) / std::max(1.0, u - 1.0);
+        double c = (vgg > 0.0) ? cyg / vgg : 0.0;
+        est = my - c * (mg - CONTROL_MEAN);
+        var_est = std::max(0.0, vyy - c * cyg) / u;
+        return;
+    }
+    est = my;
+    var_est = vyy / u;
+}
+
+// Executa uma tarefa; usado pelos workers e pelo master quando fica sem workers
+static Result run_task(const Args& args, const TaskLayout& layout, const Task& t, int rank, int kernel) {
+    // Semente: combina task_id com rank para fluxos distintos
+    uint64_t seed = args.seed ^ (uint64_t)rank ^ (t.id * 0x9E3779B97F4A7C15ULL);
+
+    Result result;
+    result.task_id = t.id;
+    if (args.mode == MODE_QMC) {
+        // Mesmo embaralhamento para toda a replica: as tarefas sao
+        // apenas faixas de indices da mesma sequencia.
+        result.acc = accum_from_hits(hits_in_circle_qmc(t.start, t.n, args.seed ^ mix64(t.replica)), t.n);
+    } else if (args.vr == VR_NONE) {
+        result.acc = accum_from_hits(hits_in_circle(t.n, seed, kernel), t.n);
+    } else {
+        result.acc = vr_eval(args.vr, t, layout.cell_samples, args.strata, seed);
+    }
+    return result;
+}
+
+// ---------------------------------------------------------------------------
+// Estado dos workers no master
+// ---------------------------------------------------------------------------
+enum WorkerState { W_IDLE = 0, W_BUSY, W_SUSPECT, W_DEAD };
+
+struct InFlight {
+    uint64_t task_id = 0;
+    double deadline = 0.0;
+};
+
+// Intervalo maximo entre testes de recepcao quando ha prazos (segundos)
+static const double POLL_INTERVAL = 1e-3;
+
+static void sleep_seconds(double s) {
+    if (s > 0.0) std::this_thread::sleep_for(std::chrono::duration<double>(s));
+}
+
+#ifdef HAVE_ULFM
+// Reconhece falhas de processo e marca os ranks mortos; devolve quantos sao novos
+static int ack_failed_ranks(std::vector<int>& state) {
+    MPI_Group failed, world;
+    MPIX_Comm_failure_ack(MPI_COMM_WORLD);
+    MPIX_Comm_failure_get_acked(MPI_COMM_WORLD, &failed);
+    MPI_Comm_group(MPI_COMM_WORLD, &world);
+    int nfailed = 0;
+    MPI_Group_size(failed, &nfailed);
+    std::vector<int> franks(nfailed), wranks(nfailed);
+    for (int i = 0; i < nfailed; ++i) franks[i] = i;
+    MPI_Group_translate_ranks(failed, nfailed, franks.data(), world, wranks.data());
+    int fresh = 0;
+    for (int r : wranks) {
+        if (r != MPI_UNDEFINED && state[r] != W_DEAD) { state[r] = W_DEAD; ++fresh; }
+    }
+    MPI_Group_free(&failed);
+    MPI_Group_free(&world);
+    return fresh;
+}
+#endif
 
+// Estatisticas de uma execucao completa (master) e de cada worker
+struct RunStats {
+    Accum total;
+    double elapsed = 0.0;
+    uint64_t reissued = 0, duplicates = 0;
+};
+
+struct WorkerStats {
+    double compute = 0.0;    // tempo em run_task
+    double idle = 0.0;       // tempo bloqueado esperando mensagem do master
+    double dispatch = 0.0;   // parte do ocioso entre enviar resultado e receber nova tarefa
+    uint64_t samples = 0;
+    uint64_t tasks = 0;
+};
+
+// MASTER: cria fila de tarefas (cada tarefa = 'batch' amostras de uma replica)
+// e distribui entre os workers 1..active; os demais so recebem STOP.
+static RunStats run_master(const Args& args, const TaskLayout& layout, int kernel,
+                           int size, int active, bool quiet) {
+    const int rank = 0;
+    RunStats run;
+    double t0 = MPI_Wtime();
+    uint64_t tasks = layout.tasks;
+
+    if (!quiet) {
         if (size < 2) {
             std::cerr << "[Aviso] Rodando com 1 processo: cálculo local. Para demonstrar distribuição, use -np >= 2.\n";
         }
@@ -105,95 +764,496 @@ int main(int argc, char** argv) {
 #ifdef _OPENMP
                   << "+OpenMP"
 #endif
-                  << ") | total samples=" << args.samples_total
-                  << " | batch=" << args.batch
+                  << ") | mode=" << (args.mode == MODE_QMC ? "qmc" : "prng")
+                  << " | kernel=" << (args.mode == MODE_QMC ? "sobol" : kernel_names[kernel])
+                  << " | total samples=" << layout.per_replica * args.replicas
+                  << " | replicas=" << args.replicas
+                  << " | batch=" << layout.batch
+                  << " | vr=" << vr_names[args.vr]
                   << " | tasks=" << tasks
-                  << " | workers=" << std::max(0, size-1)
+                  << " | workers=" << active
                   << "\n";
+    }
 
-        uint64_t total_hits = 0ULL;
-        uint64_t total_done_samples = 0ULL;
+    Accum& total = run.total;
+    std::vector<Accum> replica_acc(args.replicas);
 
-        // Distribuição inicial para até 'size-1' workers
-        uint64_t next_task_id = 0; // também usado para semente distinta
-        int workers = std::max(0, size-1);
+    int workers = std::max(0, size-1);
+    std::vector<int> state(size, W_IDLE);
+    std::vector<InFlight> inflight(size);
+    std::vector<uint8_t> done(tasks, 0);
+    std::deque<uint64_t> retry;          // tarefas com prazo estourado
+    uint64_t next_task_id = 0;
+    uint64_t received_tasks = 0;
+    uint64_t& reissued = run.reissued;
+    uint64_t& duplicates = run.duplicates;
 
-        // Envia tarefas iniciais
-        for (int w = 1; w <= workers && next_task_id < tasks; ++w) {
-            uint64_t n_for_task = (next_task_id == tasks-1 && remainder>0) ? remainder : args.batch;
-            uint64_t payload[2] = { n_for_task, next_task_id }; // [0]=amostras, [1]=id p/ semente
-            MPI_Send(payload, 2, MPI_UNSIGNED_LONG_LONG, w, TAG_TASK, MPI_COMM_WORLD);
-            ++next_task_id;
+    auto next_task = [&](uint64_t& id) -> bool {
+        while (!retry.empty()) {
+            id = retry.front();
+            retry.pop_front();
+            if (!done[id]) return true;
         }
+        if (next_task_id < tasks) { id = next_task_id++; return true; }
+        return false;
+    };
 
-        uint64_t received_tasks = 0;
-        while (received_tasks < tasks) {
-            // Recebe resultado de qualquer worker
-            uint64_t result[2]; // [0] hits, [1] samples_processadas
-            MPI_Status st;
-            MPI_Recv(result, 2, MPI_UNSIGNED_LONG_LONG, MPI_ANY_SOURCE, TAG_RESULT, MPI_COMM_WORLD, &st);
-            int src = st.MPI_SOURCE;
+    // Envia a próxima tarefa para o worker livre (ou o deixa ocioso até o fim)
+    auto dispatch = [&](int w) {
+        uint64_t id;
+        if (!next_task(id)) { state[w] = W_IDLE; return; }
+        Task t = layout.make(id);
+        uint64_t payload[4] = { t.n, t.id, t.start, t.replica };
+        MPI_Send(payload, 4, MPI_UNSIGNED_LONG_LONG, w, TAG_TASK, MPI_COMM_WORLD);
+        state[w] = W_BUSY;
+        inflight[w].task_id = id;
+        inflight[w].deadline = MPI_Wtime() + args.timeout;
+    };
 
-            total_hits += result[0];
-            total_done_samples += result[1];
-            ++received_tasks;
-
-            // Relatório parcial
-            if (args.report_every > 0 && (received_tasks % args.report_every == 0 || received_tasks == tasks)) {
-                double pi_est = 4.0 * (double) total_hits / (double) total_done_samples;
-                double pct = 100.0 * (double) received_tasks / (double) tasks;
-                std::cout << "\r[Master] tasks " << received_tasks << "/" << tasks
-                          << " (" << (int)pct << "%) | samples=" << total_done_samples
-                          << " | pi~=" << pi_est << std::flush;
-            }
+    auto accept = [&](const Result& r) {
+        if (done[r.task_id]) { ++duplicates; return; }
+        done[r.task_id] = 1;
+        total.add(r.acc);
+        replica_acc[layout.make(r.task_id).replica].add(r.acc);
+        ++received_tasks;
 
-            // Envia próxima tarefa para quem ficou livre, ou STOP se acabou
-            if (next_task_id < tasks) {
-                uint64_t n_for_task = (next_task_id == tasks-1 && remainder>0) ? remainder : args.batch;
-                uint64_t payload[2] = { n_for_task, next_task_id };
-                MPI_Send(payload, 2, MPI_UNSIGNED_LONG_LONG, src, TAG_TASK, MPI_COMM_WORLD);
-                ++next_task_id;
+        // Relatório parcial
+        if (!quiet && args.report_every > 0 && (received_tasks % args.report_every == 0 || received_tasks == tasks)) {
+            double pi_est = 0.0, var_est = 0.0;
+            vr_estimate(args.vr, total, pi_est, var_est);
+            double pct = 100.0 * (double) received_tasks / (double) tasks;
+            std::cout << "\r[Master] tasks " << received_tasks << "/" << tasks
+                      << " (" << (int)pct << "%) | samples=" << total.samples
+                      << " | pi~=" << pi_est << std::flush;
+        }
+    };
+
+    // Tarefa em andamento de um worker perdido volta para a fila
+    auto requeue = [&](int w) {
+        if (!done[inflight[w].task_id]) { retry.push_back(inflight[w].task_id); ++reissued; }
+    };
+
+    // Workers fora do conjunto ativo ficam de fora da distribuição
+    for (int w = active + 1; w <= workers; ++w) state[w] = W_DEAD;
+
+    // Distribuição inicial para os workers ativos
+    for (int w = 1; w <= active; ++w) dispatch(w);
+
+    Result result;
+    MPI_Request req = MPI_REQUEST_NULL;
+    if (active > 0)
+        MPI_Irecv(&result, (int) sizeof(Result), MPI_BYTE, MPI_ANY_SOURCE, TAG_RESULT, MPI_COMM_WORLD, &req);
+
+    auto any_busy = [&]() {
+        for (int w = 1; w <= workers; ++w)
+            if (state[w] == W_BUSY) return true;
+        return false;
+    };
+
+    while (received_tasks < tasks) {
+        int flag = 0;
+        MPI_Status st;
+        int rc = MPI_SUCCESS;
+        if (req != MPI_REQUEST_NULL) {
+            if (args.timeout <= 0.0 && any_busy()) {
+                // sem prazo nada acontece ate chegar um resultado (ou uma falha)
+                rc = MPI_Wait(&req, &st);
+                flag = (rc == MPI_SUCCESS);
             } else {
-                MPI_Send(nullptr, 0, MPI_UNSIGNED_LONG_LONG, src, TAG_STOP, MPI_COMM_WORLD);
+                rc = MPI_Test(&req, &flag, &st);
+            }
+        }
+#ifdef HAVE_ULFM
+        if (rc != MPI_SUCCESS) {
+            int ec = 0;
+            MPI_Error_class(rc, &ec);
+            if (ec == MPIX_ERR_PROC_FAILED || ec == MPIX_ERR_PROC_FAILED_PENDING) {
+                std::vector<int> before = state;
+                ack_failed_ranks(state);
+                for (int w = 1; w <= workers; ++w)
+                    if (state[w] == W_DEAD && (before[w] == W_BUSY || before[w] == W_SUSPECT)) requeue(w);
+                // PROC_FAILED completa a requisição; PENDING a mantém ativa
+                if (ec == MPIX_ERR_PROC_FAILED)
+                    MPI_Irecv(&result, (int) sizeof(Result), MPI_BYTE, MPI_ANY_SOURCE, TAG_RESULT, MPI_COMM_WORLD, &req);
             }
+            flag = 0;
+        }
+#else
+        (void) rc;
+#endif
+
+        if (flag) {
+            int src = st.MPI_SOURCE;
+            accept(result);
+            // resultado tardio reabilita um worker suspeito
+            if (state[src] == W_BUSY || state[src] == W_SUSPECT) dispatch(src);
+            if (received_tasks < tasks)
+                MPI_Irecv(&result, (int) sizeof(Result), MPI_BYTE, MPI_ANY_SOURCE, TAG_RESULT, MPI_COMM_WORLD, &req);
+            continue;
+        }
+
+        // Prazos estourados: worker vira suspeito e a tarefa volta para a fila
+        bool any_available = false;
+        double now = MPI_Wtime();
+        double nearest = now + POLL_INTERVAL;
+        if (args.timeout > 0.0) {
+            for (int w = 1; w <= workers; ++w) {
+                if (state[w] == W_BUSY && now > inflight[w].deadline) {
+                    state[w] = W_SUSPECT;
+                    requeue(w);
+                    std::cerr << "\n[Master] worker " << w << " sem resposta para a tarefa "
+                              << inflight[w].task_id << "; reemitindo\n";
+                }
+            }
+        }
+        for (int w = 1; w <= workers; ++w) {
+            if (state[w] == W_IDLE) dispatch(w);
+            if (state[w] == W_IDLE || state[w] == W_BUSY) any_available = true;
+            if (state[w] == W_BUSY) nearest = std::min(nearest, inflight[w].deadline);
         }
 
-        t1 = MPI_Wtime();
-        double pi_est = 4.0 * (double) total_hits / (double) total_done_samples;
+        // Sem workers vivos: o master calcula as tarefas restantes
+        if (!any_available) {
+            uint64_t id;
+            if (next_task(id)) accept(run_task(args, layout, layout.make(id), rank, kernel));
+        } else if (args.timeout > 0.0) {
+            sleep_seconds(nearest - now);
+        }
+    }
+
+    run.elapsed = MPI_Wtime() - t0;
+    if (!quiet) {
+        double pi_est = 0.0, var_est = 0.0;
+        vr_estimate(args.vr, total, pi_est, var_est);
         std::cout << "\nPi estimado = " << pi_est
-                  << " | amostras=" << total_done_samples
-                  << " | tempo=" << (t1 - t0) << " s\n";
+                  << " | amostras=" << total.samples
+                  << " | tempo=" << run.elapsed << " s\n";
 
-    } else {
-        // WORKER: recebe tarefas até receber STOP
-        while (true) {
-            MPI_Status st;
-            // Espia a próxima mensagem para checar TAG
-            MPI_Probe(MASTER, MPI_ANY_TAG, MPI_COMM_WORLD, &st);
-            if (st.MPI_TAG == TAG_TASK) {
-                uint64_t payload[2];
-                MPI_Recv(payload, 2, MPI_UNSIGNED_LONG_LONG, MASTER, TAG_TASK, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-                uint64_t n = payload[0];
-                uint64_t task_id = payload[1];
-
-                // Semente: combina task_id com rank para fluxos distintos
-                uint64_t seed = 0xA5A5A5A55A5A5A5AULL ^ (uint64_t)rank ^ (task_id * 0x9E3779B97F4A7C15ULL);
-
-                uint64_t h = hits_in_circle(n, seed);
-
-                uint64_t result[2] = { h, n };
-                MPI_Send(result, 2, MPI_UNSIGNED_LONG_LONG, MASTER, TAG_RESULT, MPI_COMM_WORLD);
-
-            } else if (st.MPI_TAG == TAG_STOP) {
-                MPI_Recv(nullptr, 0, MPI_UNSIGNED_LONG_LONG, MASTER, TAG_STOP, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-                break;
-            } else {
-                // descarta qualquer coisa inesperada
-                MPI_Recv(nullptr, 0, MPI_UNSIGNED_LONG_LONG, MASTER, st.MPI_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        if (args.mode == MODE_PRNG) {
+            // Fator de reducao: variancia do estimador simples com o mesmo numero
+            // de pontos dividida pela variancia obtida (>1 = melhor que o simples)
+            double p = pi_est / 4.0;
+            double var_plain = 16.0 * p * (1.0 - p);
+            double var_per_sample = var_est * (double) total.samples;
+            double factor = (var_per_sample > 0.0) ? var_plain / var_per_sample : 0.0;
+            std::cout << "VR: modo=" << vr_names[args.vr]
+                      << " | erro padrao=" << std::sqrt(var_est)
+                      << " | variancia por amostra=" << var_per_sample
+                      << " | fator de reducao=" << factor << "\n";
+        }
+
+        if (args.replicas > 1) {
+            // Media e erro padrao entre replicas (cada replica e um estimador independente)
+            double mean = 0.0, m2 = 0.0;
+            for (uint64_t r = 0; r < args.replicas; ++r) {
+                double est = 0.0, var_r = 0.0;
+                vr_estimate(args.vr, replica_acc[r], est, var_r);
+                double delta = est - mean;
+                mean += delta / (double)(r + 1);
+                m2 += delta * (est - mean);
+            }
+            double var = m2 / (double)(args.replicas - 1);
+            double stderr_mean = std::sqrt(var / (double) args.replicas);
+            std::cout << "Replicas: media=" << mean
+                      << " | erro padrao=" << stderr_mean
+                      << " | erro real=" << std::fabs(mean - M_PI) << "\n";
+        }
+    }
+
+    // Encerramento: STOP para todos os workers que nao morreram (inclusive os
+    // fora do conjunto ativo). O payload informa quantos ranks morreram para
+    // que todos encolham o comunicador juntos.
+    uint64_t dead = 0;
+    for (int w = 1; w <= active; ++w) dead += (state[w] == W_DEAD);
+    for (int w = 1; w <= workers; ++w)
+        if (state[w] != W_DEAD || w > active)
+            MPI_Send(&dead, 1, MPI_UNSIGNED_LONG_LONG, w, TAG_STOP, MPI_COMM_WORLD);
+
+    // Suspeitos ainda podem estar vivos: espera os resultados atrasados
+    auto count_suspects = [&]() {
+        int n = 0;
+        for (int w = 1; w <= workers; ++w) n += (state[w] == W_SUSPECT);
+        return n;
+    };
+    double grace_end = MPI_Wtime() + args.grace;
+    while (count_suspects() > 0 && MPI_Wtime() < grace_end) {
+        int flag = 0;
+        MPI_Status st;
+        if (req == MPI_REQUEST_NULL)
+            MPI_Irecv(&result, (int) sizeof(Result), MPI_BYTE, MPI_ANY_SOURCE, TAG_RESULT, MPI_COMM_WORLD, &req);
+        MPI_Test(&req, &flag, &st);
+        if (flag) {
+            ++duplicates;
+            if (state[st.MPI_SOURCE] == W_SUSPECT) state[st.MPI_SOURCE] = W_IDLE;
+        } else {
+            sleep_seconds(std::min(POLL_INTERVAL, grace_end - MPI_Wtime()));
+        }
+    }
+
+    if (!quiet && (args.timeout > 0.0 || dead > 0))
+        std::cout << "Tolerancia a falhas: reemitidas=" << reissued
+                  << " | duplicadas=" << duplicates
+                  << " | workers mortos=" << dead
+                  << " | sem resposta=" << count_suspects() << "\n";
+
+    if (count_suspects() > 0) {
+        // Sem ULFM nao ha como finalizar com um rank travado: o resultado
+        // esta completo, entao o job e encerrado explicitamente.
+        std::cout << "[Master] workers sem resposta apos " << args.grace
+                  << " s; encerrando com MPI_Abort\n" << std::flush;
+        MPI_Abort(MPI_COMM_WORLD, 0);
+    }
+    if (req != MPI_REQUEST_NULL) {
+        MPI_Cancel(&req);
+        MPI_Request_free(&req);
+    }
+#ifdef HAVE_ULFM
+    if (dead > 0) {
+        MPI_Comm survivors;
+        MPIX_Comm_shrink(MPI_COMM_WORLD, &survivors);
+        MPI_Comm_free(&survivors);
+    }
+#endif
+    return run;
+}
+
+// WORKER: recebe tarefas até receber STOP
+static WorkerStats run_worker(const Args& args, const TaskLayout& layout, int kernel, int rank) {
+    const int MASTER = 0;
+    WorkerStats ws;
+#ifdef MC_TEST_HOOKS
+    bool stalled = false;
+#endif
+    bool after_result = false;
+    while (true) {
+        MPI_Status st;
+        // Espia a próxima mensagem para checar TAG
+        double w0 = MPI_Wtime();
+        MPI_Probe(MASTER, MPI_ANY_TAG, MPI_COMM_WORLD, &st);
+        double waited = MPI_Wtime() - w0;
+        ws.idle += waited;
+        if (st.MPI_TAG == TAG_TASK) {
+            if (after_result) ws.dispatch += waited;
+            uint64_t payload[4];
+            MPI_Recv(payload, 4, MPI_UNSIGNED_LONG_LONG, MASTER, TAG_TASK, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            Task t;
+            t.n = payload[0];
+            t.id = payload[1];
+            t.start = payload[2];
+            t.replica = payload[3];
+
+            double c0 = MPI_Wtime();
+            Result result = run_task(args, layout, t, rank, kernel);
+            ws.compute += MPI_Wtime() - c0;
+            ws.samples += result.acc.samples;
+            ++ws.tasks;
+
+#ifdef MC_TEST_HOOKS
+            if (rank == args.stall_rank && !stalled) {
+                // simula um no lento: segura o primeiro resultado
+                stalled = true;
+                sleep_seconds(args.timeout > 0.0 ? 5.0 * args.timeout : 5.0);
+            }
+#endif
+
+            MPI_Send(&result, (int) sizeof(Result), MPI_BYTE, MASTER, TAG_RESULT, MPI_COMM_WORLD);
+            after_result = true;
+
+        } else if (st.MPI_TAG == TAG_STOP) {
+            uint64_t dead = 0;
+            MPI_Recv(&dead, 1, MPI_UNSIGNED_LONG_LONG, MASTER, TAG_STOP, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+#ifdef HAVE_ULFM
+            if (dead > 0) {
+                MPI_Comm survivors;
+                MPIX_Comm_shrink(MPI_COMM_WORLD, &survivors);
+                MPI_Comm_free(&survivors);
+            }
+#else
+            (void) dead;
+#endif
+            break;
+        } else {
+            // descarta qualquer coisa inesperada
+            MPI_Recv(nullptr, 0, MPI_UNSIGNED_LONG_LONG, MASTER, st.MPI_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        }
+    }
+    return ws;
+}
+
+// ---------------------------------------------------------------------------
+// Benchmark de escalabilidade
+// ---------------------------------------------------------------------------
+struct BenchRow {
+    std::string kind;        // strong | weak
+    int threads;
+    uint64_t batch;
+    int workers;
+    uint64_t samples;
+    double time;
+    double rate;             // amostras/s do job
+    double speedup;
+    double efficiency;
+    double rank_rate_avg;    // amostras/s por rank (tempo de calculo)
+    double rank_rate_min;
+    double dispatch_us;      // latencia media de despacho por tarefa
+    double idle_frac;        // fracao do tempo do job em que os workers ficaram ociosos
+};
+
+static void run_bench(const Args& base, int rank, int size) {
+    const int MASTER = 0;
+    std::vector<uint64_t> batches = base.bench_batches;
+    if (batches.empty()) batches = { base.batch };
+    std::vector<int> threads = base.bench_threads;
+#ifdef _OPENMP
+    if (threads.empty()) threads = { omp_get_max_threads() };
+#else
+    threads = { 1 };
+#endif
+
+    int max_workers = std::max(0, size-1);
+    std::vector<int> counts;
+    for (int w = 1; w <= max_workers; w *= 2) counts.push_back(w);
+    if (counts.empty() || counts.back() != max_workers) counts.push_back(max_workers);
+
+    std::vector<BenchRow> rows;
+    for (int th : threads) {
+#ifdef _OPENMP
+        omp_set_num_threads(std::max(1, th));
+#endif
+        for (uint64_t batch : batches) {
+            for (int kind = 0; kind < 2; ++kind) {
+                double t_ref = 0.0;
+                for (int active : counts) {
+                    Args a = base;
+                    a.batch = batch;
+                    // forte: total fixo; fraca: total proporcional aos workers
+                    if (kind == 1 && max_workers > 0)
+                        a.samples_total = base.samples_total / (uint64_t) max_workers * (uint64_t) std::max(1, active);
+                    normalize_args(a);
+                    TaskLayout layout(a);
+                    int kernel = resolve_kernel(a.kernel);
+
+                    MPI_Barrier(MPI_COMM_WORLD);
+                    RunStats run;
+                    WorkerStats ws;
+                    if (rank == MASTER) run = run_master(a, layout, kernel, size, active, true);
+                    else ws = run_worker(a, layout, kernel, rank);
+
+                    std::vector<WorkerStats> all(size);
+                    MPI_Gather(&ws, (int) sizeof(WorkerStats), MPI_BYTE,
+                               all.data(), (int) sizeof(WorkerStats), MPI_BYTE, MASTER, MPI_COMM_WORLD);
+                    if (rank != MASTER) continue;
+
+                    BenchRow r;
+                    r.kind = kind == 0 ? "strong" : "weak";
+                    r.threads = th;
+                    r.batch = layout.batch;
+                    r.workers = active;
+                    r.samples = run.total.samples;
+                    r.time = run.elapsed;
+                    r.rate = (double) r.samples / r.time;
+                    if (active == counts.front()) t_ref = r.time;
+                    // forte: T1/Tk e (T1/Tk)/k; fraca: eficiencia = T1/Tk
+                    double k = (double) std::max(1, active) / (double) std::max(1, counts.front());
+                    r.speedup = (kind == 0) ? t_ref / r.time : k * t_ref / r.time;
+                    r.efficiency = (kind == 0) ? r.speedup / k : t_ref / r.time;
+
+                    double sum_rate = 0.0, min_rate = 0.0, dispatch = 0.0, idle = 0.0;
+                    uint64_t tasks = 0;
+                    int n = 0;
+                    for (int w = 1; w <= active; ++w) {
+                        if (all[w].compute <= 0.0) continue;
+                        double rr = (double) all[w].samples / all[w].compute;
+                        sum_rate += rr;
+                        min_rate = (n == 0) ? rr : std::min(min_rate, rr);
+                        dispatch += all[w].dispatch;
+                        idle += all[w].idle;
+                        tasks += all[w].tasks;
+                        ++n;
+                    }
+                    if (active == 0) { sum_rate = min_rate = r.rate; n = 1; }
+                    r.rank_rate_avg = sum_rate / std::max(1, n);
+                    r.rank_rate_min = min_rate;
+                    r.dispatch_us = tasks > (uint64_t) n ? 1e6 * dispatch / (double)(tasks - n) : 0.0;
+                    r.idle_frac = (n > 0 && active > 0) ? idle / ((double) n * r.time) : 0.0;
+                    rows.push_back(r);
+                }
             }
         }
     }
 
+    if (rank != MASTER) return;
+
+    std::ostringstream csv, json;
+    csv << "kind,threads,batch,workers,samples,time_s,samples_per_s,speedup,efficiency,"
+           "rank_samples_per_s_avg,rank_samples_per_s_min,dispatch_latency_us,idle_frac\n";
+    json << "[\n";
+    for (size_t i = 0; i < rows.size(); ++i) {
+        const BenchRow& r = rows[i];
+        csv << r.kind << "," << r.threads << "," << r.batch << "," << r.workers << ","
+            << r.samples << "," << r.time << "," << r.rate << "," << r.speedup << ","
+            << r.efficiency << "," << r.rank_rate_avg << "," << r.rank_rate_min << ","
+            << r.dispatch_us << "," << r.idle_frac << "\n";
+        json << "  {\"kind\": \"" << r.kind << "\", \"threads\": " << r.threads
+             << ", \"batch\": " << r.batch << ", \"workers\": " << r.workers
+             << ", \"samples\": " << r.samples << ", \"time_s\": " << r.time
+             << ", \"samples_per_s\": " << r.rate << ", \"speedup\": " << r.speedup
+             << ", \"efficiency\": " << r.efficiency
+             << ", \"rank_samples_per_s_avg\": " << r.rank_rate_avg
+             << ", \"rank_samples_per_s_min\": " << r.rank_rate_min
+             << ", \"dispatch_latency_us\": " << r.dispatch_us
+             << ", \"idle_frac\": " << r.idle_frac << "}"
+             << (i + 1 < rows.size() ? "," : "") << "\n";
+    }
+    json << "]\n";
+
+    if (base.bench_out.empty()) {
+        std::cout << csv.str();
+    } else {
+        std::ofstream(base.bench_out + ".csv") << csv.str();
+        std::ofstream(base.bench_out + ".json") << json.str();
+        std::cout << "Benchmark gravado em " << base.bench_out << ".csv e "
+                  << base.bench_out << ".json (" << rows.size() << " linhas)\n";
+    }
+}
+
+int main(int argc, char** argv) {
+    MPI_Init(&argc, &argv);
+    int rank=0, size=1;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    const int MASTER = 0;
+    Args args = parse_args(argc, argv);
+    TaskLayout layout(args);
+    int kernel = resolve_kernel(args.kernel);
+
+    if (args.kernel_bench) {
+        run_kernel_bench(rank, size, args.samples_total, args.seed);
+        MPI_Finalize();
+        return 0;
+    }
+
+    if (args.mode == MODE_QMC && layout.per_replica > (1ULL << 32)) {
+        if (rank == MASTER)
+            std::cerr << "[Erro] modo qmc suporta ate 2^32 amostras por replica; use -replicas maior.\n";
+        MPI_Finalize();
+        return 1;
+    }
+
+#ifdef HAVE_ULFM
+    // Falhas de processo voltam como codigo de erro em vez de abortar o job
+    MPI_Comm_set_errhandler(MPI_COMM_WORLD, MPI_ERRORS_RETURN);
+#endif
+
+    if (args.bench) {
+        run_bench(args, rank, size);
+    } else if (rank == MASTER) {
+        run_master(args, layout, kernel, size, std::max(0, size-1), false);
+    } else {
+        run_worker(args, layout, kernel, rank);
+    }
+
     MPI_Finalize();
     return 0;
 }
@@ -0,0 +1,421 @@
+/* crivo_segmentado.h
+ * Crivo de Eratostenes segmentado compartilhado pelos contadores de primos
+ * (naiaraprime_mpi.cpp, naiaraprimemoderno.cpp, naiaraprime_lmo_mpi.cpp).
+ *
+ * - Os primos base (ate sqrt(n)) sao calculados uma vez pelo rank 0 e transmitidos
+ *   com MPI_Bcast.
+ * - Cada rank crivo um pedaco contiguo de [0, n], segmento por segmento, com uma
+ *   roda mod 30: o byte b representa os 8 numeros 30b + {1,7,11,13,17,19,23,29}
+ *   (os unicos primos com 2, 3 e 5), um bit cada (1 = ainda candidato). Um
+ *   segmento de S bytes cobre 30*S numeros; o padrao de 32 KB cabe no L1.
+ * - Pre-crivo: os multiplos de 7, 11, 13 e 17 se repetem a cada 7*11*13*17 = 17017
+ *   bytes, entao cada segmento comeca como copia desse padrao em vez de ser
+ *   crivado por esses primos.
+ * - Para um primo p, os multiplos p*q com q = r (mod 30), r na roda, caem sempre no
+ *   mesmo bit e andam p bytes: sao 8 progressoes por primo. Primos menores que o
+ *   segmento percorrem suas progressoes em cada segmento; os maiores acertam cada
+ *   segmento no maximo uma vez por progressao e vao para baldes (bucket sieve):
+ *   cada acerto fica no balde do segmento onde cai, e so e tocado quando esse
+ *   segmento e crivado.
+ * - No fim de cada segmento os primos sao contados com popcount de 64 bits; com
+ *   marcas, a mesma passada devolve tambem a contagem ate cada marca (pi em muitos
+ *   pontos de uma vez, usado no P2 do naiaraprime_lmo_mpi.cpp).
+ * - Distribuicao: crivo_conta_local da a cada rank um bloco contiguo fixo;
+ *   crivo_conta_fila corta [0, n] em blocos de custo estimado igual e os entrega
+ *   sob demanda a partir do rank 0 (crivo_fila, reaproveitavel para outros blocos).
+ * Custo O(n log log n) em vez de O(n^2) (divisao por todo j < i) ou O(n sqrt n).
+ */
+#ifndef CRIVO_SEGMENTADO_H
+#define CRIVO_SEGMENTADO_H
+
+#include <mpi.h>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+static const size_t CRIVO_SEGMENTO_BYTES = 32 * 1024;
+
+// Residuos da roda mod 30 (bit i do byte <-> residuo CRIVO_RODA[i])
+static const uint32_t CRIVO_RODA[8] = {1, 7, 11, 13, 17, 19, 23, 29};
+// Bit de cada residuo mod 30, ou -1 se nao e primo com 30
+static const int8_t CRIVO_BIT[30] = {
+    -1, 0, -1, -1, -1, -1, -1, 1, -1, -1, -1, 2, -1, 3, -1,
+    -1, -1, 4, -1, 5, -1, -1, -1, 6, -1, -1, -1, -1, -1, 7};
+// Primos tratados fora do crivo: 2, 3, 5 (fora da roda) e 7..17 (pre-crivo)
+static const uint32_t CRIVO_PEQUENOS[7] = {2, 3, 5, 7, 11, 13, 17};
+static const size_t CRIVO_PADRAO_BYTES = 7 * 11 * 13 * 17;
+
+// Raiz quadrada inteira (maior r com r*r <= n)
+inline uint64_t crivo_isqrt(uint64_t n)
+{
+    uint64_t r = (uint64_t)std::sqrt((double)n);
+    while (r * r > n) r--;
+    while ((r + 1) * (r + 1) <= n) r++;
+    return r;
+}
+
+// Primos ate limit com um crivo simples so de impares
+inline std::vector<uint32_t> crivo_primos_ate(uint32_t limit)
+{
+    std::vector<uint32_t> primos;
+    if (limit < 2) return primos;
+    primos.push_back(2);
+    std::vector<char> composto(limit / 2 + 1, 0);   // composto[i] <-> 2i + 1
+    for (uint64_t i = 1; 2 * i + 1 <= limit; i++) {
+        if (composto[i]) continue;
+        uint64_t p = 2 * i + 1;
+        primos.push_back((uint32_t)p);
+        for (uint64_t m = p * p; m <= limit; m += 2 * p) composto[m / 2] = 1;
+    }
+    return primos;
+}
+
+// Primos base para crivar ate n: calculados no rank 0 e transmitidos aos demais
+inline std::vector<uint32_t> crivo_primos_base(uint64_t n, MPI_Comm comm)
+{
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    std::vector<uint32_t> primos;
+    int quantos = 0;
+    if (rank == 0) {
+        primos = crivo_primos_ate((uint32_t)crivo_isqrt(n));
+        quantos = (int)primos.size();
+    }
+    MPI_Bcast(&quantos, 1, MPI_INT, 0, comm);
+    primos.resize(quantos);
+    MPI_Bcast(primos.data(), quantos, MPI_UINT32_T, 0, comm);
+    return primos;
+}
+
+// Padrao de pre-crivo: byte i com os multiplos de 7, 11, 13 e 17 ja riscados
+inline const std::vector<uint8_t>& crivo_padrao()
+{
+    static const std::vector<uint8_t> padrao = [] {
+        std::vector<uint8_t> v(CRIVO_PADRAO_BYTES);
+        for (size_t i = 0; i < v.size(); i++) {
+            uint8_t byte = 0;
+            for (int b = 0; b < 8; b++) {
+                uint64_t x = 30 * i + CRIVO_RODA[b];
+                if (x % 7 && x % 11 && x % 13 && x % 17) byte |= (uint8_t)(1u << b);
+            }
+            v[i] = byte;
+        }
+        return v;
+    }();
+    return padrao;
+}
+
+// Acerto pendente de um primo grande: byte dentro do segmento de destino e bit
+struct crivo_balde_item {
+    uint32_t p;
+    uint32_t pos;
+    uint32_t bit;
+};
+
+// Numero de primos em [lo, hi). primos deve conter todos os primos ate
+// sqrt(hi - 1); seg_bytes e o tamanho do segmento em bytes (30 numeros por byte).
+// Com nmarcas > 0, marcas (crescentes, em [lo, hi)) recebem em contagem[i] o numero
+// de primos em [lo, marcas[i]].
+inline uint64_t crivo_conta(uint64_t lo, uint64_t hi, const std::vector<uint32_t>& primos,
+                            size_t seg_bytes = CRIVO_SEGMENTO_BYTES,
+                            const uint64_t* marcas = nullptr, size_t nmarcas = 0, uint64_t* contagem = nullptr)
+{
+    if (hi <= lo) return 0;
+    auto pequenos_ate = [&](uint64_t x) {   // primos pequenos em [lo, x]
+        uint64_t c = 0;
+        for (uint32_t p : CRIVO_PEQUENOS)
+            if (p >= lo && p <= x) c++;
+        return c;
+    };
+    const uint64_t pequenos = pequenos_ate(hi - 1);
+    uint64_t total = 0;   // so os bits do crivo
+
+    const uint64_t b0 = lo / 30, b1 = (hi + 29) / 30;   // bytes [b0, b1)
+    const uint64_t nbytes = b1 - b0;
+    seg_bytes = std::max<size_t>(64, seg_bytes / 8 * 8);
+    const uint64_t nseg = (nbytes + seg_bytes - 1) / seg_bytes;
+    std::vector<uint8_t> seg(seg_bytes);
+    const std::vector<uint8_t>& padrao = crivo_padrao();
+
+    // Bits validos do primeiro e do ultimo byte do intervalo
+    uint8_t masc_lo = 0, masc_hi = 0;
+    for (int b = 0; b < 8; b++) {
+        if (30 * b0 + CRIVO_RODA[b] >= lo && 30 * b0 + CRIVO_RODA[b] > 1) masc_lo |= (uint8_t)(1u << b);
+        if (30 * (b1 - 1) + CRIVO_RODA[b] < hi) masc_hi |= (uint8_t)(1u << b);
+    }
+
+    // Progressoes de cada primo a partir do primeiro multiplo p*q >= max(p^2, lo),
+    // com q na roda; pos e o byte relativo a b0.
+    auto inicio = [&](uint64_t p, int r, uint64_t& pos, uint32_t& bit) {
+        uint64_t q = std::max<uint64_t>(p, (lo + p - 1) / p);
+        q += (CRIVO_RODA[r] + 30 - q % 30) % 30;
+        uint64_t m = p * q;
+        pos = m / 30 - b0;
+        bit = (uint32_t)CRIVO_BIT[m % 30];
+    };
+
+    // Primos medios (19 <= p < seg_bytes): proximo byte de cada progressao
+    size_t k0 = 0, k1 = 0, k2 = 0;
+    while (k0 < primos.size() && primos[k0] <= 17) k0++;
+    k1 = k0;
+    while (k1 < primos.size() && primos[k1] < seg_bytes && (uint64_t)primos[k1] * primos[k1] < hi) k1++;
+    k2 = k1;
+    while (k2 < primos.size() && (uint64_t)primos[k2] * primos[k2] < hi) k2++;
+    std::vector<uint64_t> prox((k1 - k0) * 8);
+    std::vector<uint8_t> prox_bit((k1 - k0) * 8);
+    for (size_t k = k0; k < k1; k++)
+        for (int r = 0; r < 8; r++) {
+            uint32_t bit;
+            inicio(primos[k], r, prox[(k - k0) * 8 + r], bit);
+            prox_bit[(k - k0) * 8 + r] = (uint8_t)bit;
+        }
+
+    // Primos grandes (p >= seg_bytes): anel de baldes, um por segmento a frente.
+    // Um acerto anda p bytes, ou seja no maximo p/seg_bytes + 1 segmentos.
+    const size_t nbaldes = k2 > k1 ? primos[k2 - 1] / seg_bytes + 2 : 1;
+    std::vector<std::vector<crivo_balde_item>> baldes(nbaldes);
+    size_t k_ativo = k1;   // primos grandes ainda nao colocados nos baldes
+    auto agenda = [&](uint32_t p, uint64_t pos, uint32_t bit) {
+        uint64_t s = pos / seg_bytes;
+        if (s < nseg) baldes[s % nbaldes].push_back({p, (uint32_t)(pos % seg_bytes), bit});
+    };
+
+    for (uint64_t s = 0; s < nseg; s++) {
+        const uint64_t ini = s * seg_bytes;
+        const size_t len = (size_t)std::min<uint64_t>(seg_bytes, nbytes - ini);
+        const uint64_t fim = ini + len;
+
+        // Pre-crivo: copia o padrao a partir do byte absoluto b0 + ini
+        size_t off = (size_t)((b0 + ini) % CRIVO_PADRAO_BYTES);
+        for (size_t feito = 0; feito < len;) {
+            size_t n = std::min(len - feito, CRIVO_PADRAO_BYTES - off);
+            std::memcpy(seg.data() + feito, padrao.data() + off, n);
+            feito += n;
+            off = 0;
+        }
+
+        // Primos medios: as 8 progressoes ficam numa janela de ~p bytes, entao
+        // enquanto a janela inteira cabe no segmento risca-se uma volta da roda
+        // (8 bytes) por iteracao; o resto vai progressao por progressao.
+        for (size_t k = k0; k < k1; k++) {
+            const uint64_t p = primos[k];
+            uint64_t* pr = &prox[(k - k0) * 8];
+            const uint8_t* pb = &prox_bit[(k - k0) * 8];
+            uint64_t base = *std::min_element(pr, pr + 8);
+            uint64_t dmax = *std::max_element(pr, pr + 8) - base;
+            if (base >= ini && base + dmax < fim) {
+                size_t d[8];
+                uint8_t masc[8];
+                for (int r = 0; r < 8; r++) {
+                    d[r] = (size_t)(pr[r] - base);
+                    masc[r] = (uint8_t)~(1u << pb[r]);
+                }
+                uint8_t* b = seg.data() + (base - ini);
+                uint8_t* const b_fim = seg.data() + len - dmax;
+                for (; b < b_fim; b += p) {
+                    b[d[0]] &= masc[0]; b[d[1]] &= masc[1]; b[d[2]] &= masc[2]; b[d[3]] &= masc[3];
+                    b[d[4]] &= masc[4]; b[d[5]] &= masc[5]; b[d[6]] &= masc[6]; b[d[7]] &= masc[7];
+                }
+                for (int r = 0; r < 8; r++) pr[r] = ini + (uint64_t)(b - seg.data()) + d[r];
+            }
+            for (int r = 0; r < 8; r++) {
+                uint64_t j = pr[r];
+                if (j >= fim) continue;
+                const uint8_t masc = (uint8_t)~(1u << pb[r]);
+                for (j -= ini; j < len; j += p) seg[j] &= masc;
+                pr[r] = ini + j;
+            }
+        }
+
+        // Primos grandes: ativa os que comecam (p^2) ate o fim deste segmento
+        while (k_ativo < k2 && std::max<uint64_t>((uint64_t)primos[k_ativo] * primos[k_ativo], lo) / 30 - b0 < fim) {
+            for (int r = 0; r < 8; r++) {
+                uint64_t pos;
+                uint32_t bit;
+                inicio(primos[k_ativo], r, pos, bit);
+                agenda(primos[k_ativo], pos, bit);
+            }
+            k_ativo++;
+        }
+        std::vector<crivo_balde_item>& balde = baldes[s % nbaldes];
+        for (const crivo_balde_item& e : balde) {
+            const uint8_t masc = (uint8_t)~(1u << e.bit);
+            uint64_t j = e.pos;
+            do {
+                seg[j] &= masc;
+                j += e.p;
+            } while (j < seg_bytes);
+            agenda(e.p, ini + j, e.bit);
+        }
+        balde.clear();
+
+        // Bordas do intervalo e contagem (popcount de 8 bytes por vez)
+        if (s == 0) seg[0] &= masc_lo;
+        if (s == nseg - 1) {
+            seg[len - 1] &= masc_hi;
+            std::memset(seg.data() + len, 0, seg_bytes - len);
+        }
+        auto palavra = [&](size_t w) {
+            uint64_t x;
+            std::memcpy(&x, seg.data() + 8 * w, sizeof x);
+            return x;
+        };
+        size_t palavras = (len + 7) / 8, w = 0;
+        // marcas deste segmento: soma as palavras ate a da marca e conta na palavra
+        // da marca os bytes anteriores e os bits com residuo <= o da marca
+        for (; nmarcas > 0 && marcas[0] / 30 - b0 < fim; marcas++, nmarcas--, contagem++) {
+            size_t byte = (size_t)(marcas[0] / 30 - b0 - ini);
+            for (; w < byte / 8; w++) total += (uint64_t)__builtin_popcountll(palavra(w));
+            uint32_t r = (uint32_t)(marcas[0] % 30);
+            uint64_t bits = 0;
+            for (int b = 0; b < 8; b++)
+                if (CRIVO_RODA[b] <= r) bits |= 1ULL << b;
+            uint64_t masc = ((1ULL << (8 * (byte % 8))) - 1) | (bits << (8 * (byte % 8)));
+            *contagem = pequenos_ate(marcas[0]) + total + (uint64_t)__builtin_popcountll(palavra(w) & masc);
+        }
+        for (; w < palavras; w++) total += (uint64_t)__builtin_popcountll(palavra(w));
+    }
+    return pequenos + total;
+}
+
+// Primos em [0, n] do pedaco deste rank: os bytes da roda (30 numeros cada) sao
+// divididos em blocos contiguos iguais, e o 2 cai no rank 0. Somar sobre os ranks
+// da pi(n).
+inline uint64_t crivo_conta_local(uint64_t n, const std::vector<uint32_t>& primos, int rank, int size,
+                                  size_t seg_bytes = CRIVO_SEGMENTO_BYTES)
+{
+    uint64_t nbytes = n / 30 + 1;
+    uint64_t i0 = nbytes / size * rank + std::min<uint64_t>(rank, nbytes % size);
+    uint64_t i1 = i0 + nbytes / size + ((uint64_t)rank < nbytes % size ? 1 : 0);
+    return crivo_conta(30 * i0, std::min<uint64_t>(30 * i1, n + 1), primos, seg_bytes);
+}
+
+// Custo estimado de crivar um byte da roda em torno de x: a copia do padrao e o
+// popcount (~1) mais os riscos, 8 * soma de 1/p para 19 <= p <= sqrt(x), que pelo
+// teorema de Mertens e ~8 * (ln ln sqrt(x) - ln ln 19). Blocos altos custam mais
+// por numero (mais primos base), ate ~1.5x entre 1e6 e 1e10.
+inline double crivo_custo_byte(double x)
+{
+    const double lnln19 = std::log(std::log(19.0));
+    double r = std::sqrt(std::max(x, 361.0));
+    return 1.0 + 8.0 * (std::log(std::log(r)) - lnln19);
+}
+
+// Fronteiras (multiplos de 30) de nblocos blocos de [0, n] com o mesmo custo
+// estimado. Cada bloco paga ainda a preparacao dos primos base (8 progressoes por
+// primo ate sqrt do fim do bloco), contada como ~8 bytes por primo.
+inline std::vector<uint64_t> crivo_blocos(uint64_t n, int nblocos, const std::vector<uint32_t>& primos,
+                                          size_t seg_bytes = CRIVO_SEGMENTO_BYTES)
+{
+    const uint64_t nbytes = n / 30 + 1;
+    const uint64_t passo = std::max<size_t>(64, seg_bytes);
+    auto preparo = [&](uint64_t byte_fim) {
+        uint64_t r = crivo_isqrt(30 * byte_fim);
+        return 8.0 * (double)(std::upper_bound(primos.begin(), primos.end(), r) - primos.begin());
+    };
+    double total = preparo(nbytes) * nblocos;
+    for (uint64_t b = 0; b < nbytes; b += passo)
+        total += (double)std::min(passo, nbytes - b) * crivo_custo_byte(30.0 * (double)(b + passo / 2));
+
+    std::vector<uint64_t> fronteiras(1, 0);
+    const double alvo = total / nblocos;
+    double acumulado = 0.0;
+    for (uint64_t b = 0; b < nbytes && (int)fronteiras.size() < nblocos; b += passo) {
+        acumulado += (double)std::min(passo, nbytes - b) * crivo_custo_byte(30.0 * (double)(b + passo / 2));
+        if (acumulado + preparo(b + passo) >= alvo) {
+            fronteiras.push_back(30 * std::min(b + passo, nbytes));
+            acumulado = 0.0;
+        }
+    }
+    if (fronteiras.back() < n + 1) fronteiras.push_back(n + 1);
+    else fronteiras.back() = n + 1;
+    return fronteiras;
+}
+
+static const int CRIVO_TAG_PEDIDO = 101;
+static const int CRIVO_TAG_BLOCO = 102;
+
+// Fila de blocos 0..nblocos-1: o rank 0 distribui o indice do proximo bloco a
+// quem pedir e faz_bloco(b) e chamado em quem o recebeu. Cada worker mantem dois
+// pedidos em andamento (trabalha num bloco com o proximo ja garantido), entao o
+// rank 0, que tambem trabalha e so atende entre um bloco e outro, tem um bloco
+// inteiro de folga para responder. Cada worker recebe dois -1 no fim.
+template <class F>
+inline void crivo_fila(MPI_Comm comm_usuario, int nblocos, F&& faz_bloco)
+{
+    // comunicador proprio: os pedidos de uma chamada nao se misturam com os da
+    // seguinte (um worker que ja terminou pode pedir antes do rank 0 acabar)
+    MPI_Comm comm;
+    MPI_Comm_dup(comm_usuario, &comm);
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    if (rank == 0) {
+        int prox = 0, ativos = 2 * (size - 1);   // respostas -1 ainda por mandar
+        // Atende um pedido: o proximo bloco, ou -1 quando a fila acabou
+        auto atende = [&](int origem) {
+            int dummy, bloco = prox < nblocos ? prox++ : -1;
+            MPI_Recv(&dummy, 1, MPI_INT, origem, CRIVO_TAG_PEDIDO, comm, MPI_STATUS_IGNORE);
+            MPI_Send(&bloco, 1, MPI_INT, origem, CRIVO_TAG_BLOCO, comm);
+            if (bloco < 0) ativos--;
+        };
+        auto atende_pendentes = [&]() {
+            int flag = 1;
+            MPI_Status st;
+            while (ativos > 0 && flag) {
+                MPI_Iprobe(MPI_ANY_SOURCE, CRIVO_TAG_PEDIDO, comm, &flag, &st);
+                if (flag) atende(st.MPI_SOURCE);
+            }
+        };
+        // os dois primeiros pedidos de cada worker chegam logo: atende antes de trabalhar
+        for (int i = 0; i < 2 * (size - 1); i++) {
+            MPI_Status st;
+            MPI_Probe(MPI_ANY_SOURCE, CRIVO_TAG_PEDIDO, comm, &st);
+            atende(st.MPI_SOURCE);
+        }
+        while (prox < nblocos || ativos > 0) {
+            atende_pendentes();
+            if (prox < nblocos) {
+                faz_bloco(prox++);
+            } else if (ativos > 0) {
+                MPI_Status st;
+                MPI_Probe(MPI_ANY_SOURCE, CRIVO_TAG_PEDIDO, comm, &st);
+                atende(st.MPI_SOURCE);
+            }
+        }
+    } else {
+        int pedido = 0, bloco;
+        MPI_Send(&pedido, 1, MPI_INT, 0, CRIVO_TAG_PEDIDO, comm);
+        MPI_Send(&pedido, 1, MPI_INT, 0, CRIVO_TAG_PEDIDO, comm);
+        for (;;) {
+            MPI_Recv(&bloco, 1, MPI_INT, 0, CRIVO_TAG_BLOCO, comm, MPI_STATUS_IGNORE);
+            if (bloco < 0) break;
+            MPI_Send(&pedido, 1, MPI_INT, 0, CRIVO_TAG_PEDIDO, comm);   // repoe o pedido adiantado
+            faz_bloco(bloco);
+        }
+        // a resposta ao pedido que ainda estava em andamento tambem e -1
+        MPI_Recv(&bloco, 1, MPI_INT, 0, CRIVO_TAG_BLOCO, comm, MPI_STATUS_IGNORE);
+    }
+    MPI_Comm_free(&comm);
+}
+
+// Primos em [0, n] dos blocos que este rank tirou da fila: [0, n] e cortado em
+// blocos_por_rank * size blocos de custo estimado igual (crivo_blocos) e
+// distribuido por crivo_fila. Somar sobre os ranks da pi(n).
+inline uint64_t crivo_conta_fila(uint64_t n, const std::vector<uint32_t>& primos, MPI_Comm comm,
+                                 int blocos_por_rank = 8, size_t seg_bytes = CRIVO_SEGMENTO_BYTES)
+{
+    int size;
+    MPI_Comm_size(comm, &size);
+    const std::vector<uint64_t> f = crivo_blocos(n, std::max(1, blocos_por_rank) * size, primos, seg_bytes);
+    uint64_t total = 0;
+    crivo_fila(comm, (int)f.size() - 1, [&](int b) {
+        total += crivo_conta(f[b], f[b + 1], primos, seg_bytes);
+    });
+    return total;
+}
+
+#endif
@@ -3,42 +3,218 @@
 #include <mpi.h>
 #include <string.h>
 #include <unistd.h>
+#include <math.h>
+#include <float.h>
+#include <stdint.h>
 
-#define N 2000 /* number of rows and columns in matrix */
+#include "../matriz_kernels.h"
+
+/* Usage: mpirun -np P ./naiaramultimatrizotimizado_mpi [-n N] [-kernel naive|generic|avx2|avx512|auto]
+ *                                                      [-calibrate] [-dynamic CHUNK] [-freivalds R]
+ * N is read at run time (default 2000); matrices live on the heap, 64-byte aligned
+ * (huge pages for big blocks), and each worker only allocates its slab of a/c plus b.
+ * The master computes its own share of rows too, so -np 1 also works.
+ * -calibrate times a small multiply on every rank and sizes the slabs in proportion
+ * to the measured GFLOPS, for clusters that mix CPU generations.
+ * -dynamic keeps the last quarter of the rows out of the slabs and hands them out
+ * CHUNK rows at a time to whichever rank asks first.
+ * The result is verified with R rounds of Freivalds' check (default 2, 0 = off):
+ * O(N^2) per round, spread over the ranks. */
 
 MPI_Status status;
-double a[N][N], b[N][N], c[N][N];
+
+/* Tags of the dynamic phase: request (worker has / has not a result), chunk offset
+ * (-1 = no more work), chunk of a, chunk of c */
+#define TAG_REQ   3
+#define TAG_OFF   4
+#define TAG_A     5
+#define TAG_C     6
+
+/* Columns of b per call while the master has transfers to progress: each call packs
+ * only that panel of b and keeps the full MC row blocks (as matriz.cpp's -panel) */
+#define MASTER_PANEL 512
+
+/* c[m x n] = a[m x N] * b[N x n], all with leading dimension N */
+static void multiply_rows(const dgemm_plan_t *plan, int naive, int m, int n, int N,
+                          const double *a, const double *b, double *c)
+{
+    if (naive)
+        dgemm_naive(m, n, N, a, N, b, N, c, N);
+    else
+        dgemm_blocked(plan, m, n, N, a, N, b, N, 0, c, N);
+}
+
+/* GFLOPS of this rank on a small multiply with the same kernel (best of 3) */
+static double calibrate_gflops(const dgemm_plan_t *plan, int naive, int N)
+{
+    int n = N < 384 ? N : 384, r;
+    size_t i;
+    double best = 1e30;
+    double *x = mk_matrix_alloc(n, n), *y = mk_matrix_alloc(n, n), *z = mk_matrix_alloc(n, n);
+    if (!x || !y || !z || n == 0) {
+        mk_matrix_free(x); mk_matrix_free(y); mk_matrix_free(z);
+        return 1.0;
+    }
+    for (i = 0; i < (size_t)n * n; i++) {
+        x[i] = 1.0;
+        y[i] = 2.0;
+    }
+    for (r = 0; r < 3; r++) {
+        double t = MPI_Wtime();
+        multiply_rows(plan, naive, n, n, n, x, y, z);
+        t = MPI_Wtime() - t;
+        if (t < best) best = t;
+    }
+    mk_matrix_free(x); mk_matrix_free(y); mk_matrix_free(z);
+    return 2.0 * n * n * n / (best > 1e-9 ? best : 1e-9) / 1e9;
+}
+
+/* Master side of the dynamic phase: answer the request of src, first taking the
+ * chunk it finished (if any), then giving it the next one or telling it to stop */
+static void serve_request(int src, int N, int chunk, double *a, double *c, int *assigned,
+                          int *next, int *active, MPI_Datatype rowtype)
+{
+    int have, off;
+    MPI_Recv(&have, 1, MPI_INT, src, TAG_REQ, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    if (have) {
+        off = assigned[src];
+        MPI_Recv(&c[(size_t)off * N], N - off < chunk ? N - off : chunk, rowtype,
+                 src, TAG_C, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    }
+    off = *next < N ? *next : -1;
+    MPI_Send(&off, 1, MPI_INT, src, TAG_OFF, MPI_COMM_WORLD);
+    if (off >= 0) {
+        int m = N - off < chunk ? N - off : chunk;
+        MPI_Send(&a[(size_t)off * N], m, rowtype, src, TAG_A, MPI_COMM_WORLD);
+        assigned[src] = off;
+        *next += m;
+    } else {
+        (*active)--;
+    }
+}
+
+/* Freivalds' check of the rows of c this rank holds, given as nr ranges of global
+ * rows [g0, g1) stored from local row l0 on, with the shared helpers of
+ * matriz_kernels.h. Every rank has all of b, so y = Bx is computed for the same rows
+ * and completed with one Allreduce; the rest is local, O(N^2 rounds / P) per rank.
+ * Returns on every rank the largest normalized residual, which the master compares
+ * with MK_FREIVALDS_TOL. */
+static double freivalds(int N, int rounds, uint64_t seed, int nr, const int *g0, const int *g1,
+                        const int *l0, const double *a, const double *b, const double *c)
+{
+    size_t nx = (size_t)N * rounds;
+    double *x = (double *)malloc(sizeof(double) * (nx ? nx : 1));
+    double *y = (double *)calloc(2 * nx + 1, sizeof(double));   /* Bx, then |B||x| */
+    double worst = 0.0, w;
+    int q;
+    mk_freivalds_x(N, rounds, seed, x);
+    for (q = 0; q < nr; q++)
+        dgemm_freivalds_bx(N, rounds, x, g0[q], g1[q], b, y);
+    MPI_Allreduce(MPI_IN_PLACE, y, (int)(2 * nx), MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    for (q = 0; q < nr; q++) {
+        w = dgemm_freivalds_res(N, rounds, x, y, g1[q] - g0[q], a + (size_t)l0[q] * N, c + (size_t)l0[q] * N);
+        if (w > worst)
+            worst = w;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &worst, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    free(x);
+    free(y);
+    return worst;
+}
+
+/* Serve every request already waiting, without blocking */
+static void serve_pending(int N, int chunk, double *a, double *c, int *assigned,
+                          int *next, int *active, MPI_Datatype rowtype)
+{
+    int flag = 1;
+    while (*active > 0 && flag) {
+        MPI_Iprobe(MPI_ANY_SOURCE, TAG_REQ, MPI_COMM_WORLD, &flag, &status);
+        if (flag)
+            serve_request(status.MPI_SOURCE, N, chunk, a, c, assigned, next, active, rowtype);
+    }
+}
 
 int main(int argc, char **argv)
 {
-    int numtasks, taskid, numworkers, source, dest, rows, offset, i, j, k;
-    double t1, t2;
+    int numtasks, taskid, numworkers, dest, rows, i, j;
+    double t1 = 0.0, t2;
     char processor_name[MPI_MAX_PROCESSOR_NAME];
     int name_len;
+    const char *kernel = "auto"; /* naive | generic | avx2 | avx512 | auto */
+    int N = 2000;                /* number of rows and columns in matrix */
+    int calibrate = 0;           /* slabs proportional to measured GFLOPS */
+    int dyn_chunk = 0;           /* rows per chunk of the dynamic phase (0 = off) */
+    int rounds = 2;              /* Freivalds rounds (0 = no verification) */
+    double *a = NULL, *b = NULL, *c = NULL;
+    MPI_Datatype rowtype;        /* one matrix row, so counts stay below INT_MAX */
+    
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            N = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-kernel") == 0 && i + 1 < argc)
+            kernel = argv[++i];
+        else if (strcmp(argv[i], "-calibrate") == 0)
+            calibrate = 1;
+        else if (strcmp(argv[i], "-dynamic") == 0 && i + 1 < argc)
+            dyn_chunk = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-freivalds") == 0 && i + 1 < argc)
+            rounds = atoi(argv[++i]);
+    }
     
-    MPI_Init(&argc, &argv);
+    int provided;    /* OpenMP threads (-fopenmp) run inside dgemm_blocked; only the main thread calls MPI */
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
     MPI_Comm_rank(MPI_COMM_WORLD, &taskid);
     MPI_Comm_size(MPI_COMM_WORLD, &numtasks);
     MPI_Get_processor_name(processor_name, &name_len);
+    MPI_Type_contiguous(N, MPI_DOUBLE, &rowtype);
+    MPI_Type_commit(&rowtype);
     
     numworkers = numtasks - 1;
     
+    int naive = strcmp(kernel, "naive") == 0;
+    dgemm_plan_t plan = dgemm_plan(kernel, 0, 0, 0);
+    
+    /* Rows of every rank, computed everywhere instead of sent: the master takes
+     * its own share and the first N % numtasks ranks get one extra row. With
+     * -dynamic only the first static_rows are split this way. */
+    if (dyn_chunk < 0)
+        dyn_chunk = 0;
+    int static_rows = dyn_chunk > 0 ? N - N / 4 : N;
+    int *counts = (int *)calloc(numtasks, sizeof(int));
+    int *displs = (int *)calloc(numtasks, sizeof(int));
+    double *rate = (double *)calloc(numtasks, sizeof(double));
+    if (calibrate) {
+        /* every rank learns every rate, then cuts [0, static_rows) at the rounded
+         * cumulative shares so the counts always add up */
+        double mine = calibrate_gflops(&plan, naive, N), total = 0.0, cum = 0.0;
+        MPI_Allgather(&mine, 1, MPI_DOUBLE, rate, 1, MPI_DOUBLE, MPI_COMM_WORLD);
+        for (dest = 0; dest < numtasks; dest++)
+            total += rate[dest];
+        for (dest = 0; dest < numtasks; dest++) {
+            int end;
+            cum += rate[dest];
+            end = dest == numtasks - 1 ? static_rows : (int)((double)static_rows * cum / total + 0.5);
+            displs[dest] = dest == 0 ? 0 : displs[dest - 1] + counts[dest - 1];
+            counts[dest] = end - displs[dest];
+        }
+    } else {
+        for (dest = 0; dest < numtasks; dest++) {
+            counts[dest] = static_rows / numtasks + (dest < static_rows % numtasks ? 1 : 0);
+            displs[dest] = dest == 0 ? 0 : displs[dest - 1] + counts[dest - 1];
+        }
+    }
+    rows = counts[taskid];
+    
     /*---------------------------- master ----------------------------*/
     if (taskid == 0) {
         printf("🖥️  CLUSTER MATRIX MULTIPLICATION\n");
         printf("================================\n");
         printf("Matrix size: %d x %d\n", N, N);
-        printf("Total processes: %d\n", numtasks);
+        printf("Total processes: %d (x %d threads)\n", numtasks, mk_num_threads());
         printf("Number of workers: %d\n", numworkers);
         printf("Master node: %s\n", processor_name);
         printf("================================\n");
         
-        if (numworkers == 0) {
-            printf("❌ ERROR: Need at least 2 processes\n");
-            MPI_Finalize();
-            return 1;
-        }
-        
         // Mostrar informações dos workers
         printf("📡 Gathering worker information...\n");
         fflush(stdout);
@@ -48,61 +224,194 @@ int main(int argc, char **argv)
         printf("🔧 Initializing matrices...\n");
         fflush(stdout);
         
+        a = mk_matrix_alloc(N, N);
+        b = mk_matrix_alloc(N, N);
+        c = mk_matrix_alloc(N, N);
+        if (!a || !b || !c) {
+            printf("❌ ERROR: cannot allocate 3 x %d x %d doubles on the master\n", N, N);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        
         // Initialize matrices
         for (i = 0; i < N; i++) {
             for (j = 0; j < N; j++) {
-                a[i][j] = 1.0;
-                b[i][j] = 2.0;
+                a[(size_t)i * N + j] = 1.0;
+                b[(size_t)i * N + j] = 2.0;
             }
         }
         
         printf("✅ Matrices initialized\n");
-        printf("📤 Distributing work to %d workers...\n", numworkers);
-        
-        // Calculate work distribution
-        rows = N / numworkers;
-        int remaining_rows = N % numworkers;
-        offset = 0;
+        printf("📤 Distributing work to %d workers (master included)...\n", numtasks);
         
         printf("📊 Work distribution:\n");
-        printf("   Base rows per worker: %d\n", rows);
-        printf("   Extra rows for first workers: %d\n", remaining_rows);
+        if (calibrate) {
+            printf("   Rows proportional to calibrated GFLOPS\n");
+        } else {
+            printf("   Base rows per process: %d\n", static_rows / numtasks);
+            printf("   Extra rows for first processes: %d\n", static_rows % numtasks);
+        }
+        if (dyn_chunk > 0)
+            printf("   Dynamic rows: %d (chunks of %d)\n", N - static_rows, dyn_chunk);
         printf("   Total operations: %.2f billion\n", (double)N * N * N / 1e9);
-        
-        /* send matrix data to the worker tasks */
+        if (calibrate)
+            printf("📌 Master: %d rows (offset=0, %.2f GFLOPS)\n", counts[0], rate[0]);
+        else
+            printf("📌 Master: %d rows (offset=0)\n", counts[0]);
         for (dest = 1; dest <= numworkers; dest++) {
-            int current_rows = rows + (dest <= remaining_rows ? 1 : 0);
-            
-            printf("📤 Sending to worker %d: %d rows (offset=%d)\n", 
-                   dest, current_rows, offset);
-            fflush(stdout);
-            
-            MPI_Send(&offset, 1, MPI_INT, dest, 1, MPI_COMM_WORLD);
-            MPI_Send(&current_rows, 1, MPI_INT, dest, 1, MPI_COMM_WORLD);
-            MPI_Send(&a[offset][0], current_rows * N, MPI_DOUBLE, dest, 1, MPI_COMM_WORLD);
-            MPI_Send(&b, N * N, MPI_DOUBLE, dest, 1, MPI_COMM_WORLD);
-            offset = offset + current_rows;
+            if (calibrate)
+                printf("📤 Worker %d: %d rows (offset=%d, %.2f GFLOPS)\n",
+                       dest, counts[dest], displs[dest], rate[dest]);
+            else
+                printf("📤 Worker %d: %d rows (offset=%d)\n", dest, counts[dest], displs[dest]);
         }
+        fflush(stdout);
+    } else {
+        // Only this worker's slab of a and c, plus b
+        a = mk_matrix_alloc(rows, N);
+        b = mk_matrix_alloc(N, N);
+        c = mk_matrix_alloc(rows, N);
+        if (!a || !b || !c) {
+            printf("❌ Worker %d: cannot allocate %.1f MB\n", taskid,
+                   8.0 * ((double)N * N + 2.0 * rows * N) / 1e6);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        // First-touch pelas threads que vao usar as paginas (NUMA): a e c por
+        // linhas, b pelos micro-paineis de colunas que cada thread empacota
+        mk_first_touch(a, rows, N);
+        mk_first_touch_panels(b, N, N, sizeof(double), plan.kern->nr, plan.nc);
+        mk_first_touch(c, rows, N);
+    }
+    
+    /* b goes out with a tree broadcast, the a slabs with a single scatter; both are
+     * nonblocking so the master starts on its own rows while they are in flight */
+    MPI_Request coll[2];
+    MPI_Ibcast(b, N, rowtype, 0, MPI_COMM_WORLD, &coll[0]);
+    MPI_Iscatterv(a, counts, displs, rowtype,
+                  taskid == 0 ? MPI_IN_PLACE : a, rows, rowtype, 0, MPI_COMM_WORLD, &coll[1]);
+    
+    /* the master also posts one receive per worker straight into its slab of c */
+    MPI_Request *reqs = NULL;
+    if (taskid == 0) {
+        reqs = (MPI_Request *)malloc(sizeof(MPI_Request) * (numworkers > 0 ? numworkers : 1));
+        for (i = 1; i <= numworkers; i++)
+            MPI_Irecv(&c[(size_t)displs[i] * N], counts[i], rowtype, i, 2, MPI_COMM_WORLD, &reqs[i - 1]);
+    } else {
+        MPI_Waitall(2, coll, MPI_STATUSES_IGNORE);
         
+        // Enviar informação do nó para o master
+        printf("🔧 Worker %d starting on node: %s\n", taskid, processor_name);
+        printf("💼 Worker %d (%s): Processing %d rows (offset=%d)\n", 
+               taskid, processor_name, rows, displs[taskid]);
+        printf("🔄 Worker %d: Starting computation...\n", taskid);
+        fflush(stdout);
+    }
+    
+    /*---------------------- computation (all ranks) ----------------------*/
+    const char *who = taskid == 0 ? "Master" : "Worker";
+    double worker_start = MPI_Wtime();
+    
+    /* Matrix multiplication: packed/blocked kernel, or the original loop as reference.
+     * The master's slab is the first rows of its full a/c; with workers it goes through
+     * b in column panels and tests the pending transfers in between so they keep
+     * progressing. */
+    int panel = (taskid == 0 && numworkers > 0) ? MASTER_PANEL : (N > 0 ? N : 1);
+    int next = static_rows, active = dyn_chunk > 0 ? numworkers : 0, dyn_rows = 0;
+    int *assigned = (int *)calloc(numtasks, sizeof(int));
+    if (naive)
+        printf("🧮 %s %d (%s): kernel naive\n", who, taskid, processor_name);
+    else
+        printf("🧮 %s %d (%s): kernel %s (%dx%d, mc=%d kc=%d nc=%d)\n",
+               who, taskid, processor_name, plan.kern->name, plan.kern->mr, plan.kern->nr,
+               plan.mc, plan.kc, plan.nc);
+    fflush(stdout);
+    for (j = 0; j < N; j += panel) {
+        int w = N - j < panel ? N - j : panel;
+        multiply_rows(&plan, naive, rows, w, N, a, b + j, c + j);
+        if (taskid == 0) {
+            int done;
+            MPI_Testall(2, coll, &done, MPI_STATUSES_IGNORE);
+            serve_pending(N, dyn_chunk, a, c, assigned, &next, &active, rowtype);
+        }
+    }
+    
+    if (taskid == 0 && dyn_chunk > 0) {
+        /* Dynamic phase: the master takes chunks of the remaining rows itself and
+         * answers the workers in between; once the rows run out it only answers,
+         * until every worker has been told to stop */
+        while (next < N || active > 0) {
+            if (next < N) {
+                int off = next, m = N - off < dyn_chunk ? N - off : dyn_chunk;
+                next += m;
+                multiply_rows(&plan, naive, m, N, N, a + (size_t)off * N, b, c + (size_t)off * N);
+                dyn_rows += m;
+                serve_pending(N, dyn_chunk, a, c, assigned, &next, &active, rowtype);
+            } else {
+                MPI_Probe(MPI_ANY_SOURCE, TAG_REQ, MPI_COMM_WORLD, &status);
+                serve_request(status.MPI_SOURCE, N, dyn_chunk, a, c, assigned, &next, &active, rowtype);
+            }
+        }
+    } else if (taskid != 0) {
+        /* the static slab goes back before the worker asks for more work */
+        printf("📤 Worker %d: Sending results to master...\n", taskid);
+        fflush(stdout);
+        MPI_Send(c, rows, rowtype, 0, 2, MPI_COMM_WORLD);
+        
+        if (dyn_chunk > 0) {
+            double *achunk = mk_matrix_alloc(dyn_chunk, N);
+            double *cchunk = mk_matrix_alloc(dyn_chunk, N);
+            int have = 0, off, m = 0;
+            if (!achunk || !cchunk) {
+                printf("❌ Worker %d: cannot allocate the dynamic chunks\n", taskid);
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            for (;;) {
+                MPI_Send(&have, 1, MPI_INT, 0, TAG_REQ, MPI_COMM_WORLD);
+                if (have)
+                    MPI_Send(cchunk, m, rowtype, 0, TAG_C, MPI_COMM_WORLD);
+                MPI_Recv(&off, 1, MPI_INT, 0, TAG_OFF, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                if (off < 0)
+                    break;
+                m = N - off < dyn_chunk ? N - off : dyn_chunk;
+                MPI_Recv(achunk, m, rowtype, 0, TAG_A, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                multiply_rows(&plan, naive, m, N, N, achunk, b, cchunk);
+                dyn_rows += m;
+                have = 1;
+            }
+            mk_matrix_free(achunk);
+            mk_matrix_free(cchunk);
+        }
+    }
+    
+    double worker_end = MPI_Wtime();
+    if (dyn_chunk > 0)
+        printf("✅ %s %d (%s): Completed %d + %d dynamic rows in %.2f seconds (%.2f GFLOPS)\n", 
+               who, taskid, processor_name, rows, dyn_rows, worker_end - worker_start,
+               2.0 * (rows + dyn_rows) * N * N / (worker_end - worker_start) / 1e9);
+    else
+        printf("✅ %s %d (%s): Completed in %.2f seconds (%.2f GFLOPS)\n", 
+               who, taskid, processor_name, worker_end - worker_start,
+               2.0 * rows * N * N / (worker_end - worker_start) / 1e9);
+    fflush(stdout);
+    free(assigned);
+    
+    if (taskid == 0) {
+        MPI_Waitall(2, coll, MPI_STATUSES_IGNORE);
         printf("✅ All data distributed\n");
-        printf("⏳ Waiting for results... (estimated: 1-3 minutes)\n");
+        printf("⏳ Waiting for results...\n");
         printf("================================\n");
         fflush(stdout);
         
-        /* wait for results from all worker tasks */
-        int completed_workers = 0;
-        for (i = 1; i <= numworkers; i++) {
-            source = i;
-            
-            MPI_Recv(&offset, 1, MPI_INT, source, 2, MPI_COMM_WORLD, &status);
-            MPI_Recv(&rows, 1, MPI_INT, source, 2, MPI_COMM_WORLD, &status);
-            MPI_Recv(&c[offset][0], rows * N, MPI_DOUBLE, source, 2, MPI_COMM_WORLD, &status);
-            
-            completed_workers++;
+        /* take the workers in whatever order they finish so a slow one does not
+         * hold up the rest */
+        int completed_workers;
+        for (completed_workers = 1; completed_workers <= numworkers; completed_workers++) {
+            int idx;
+            MPI_Waitany(numworkers, reqs, &idx, &status);
             printf("📥 Worker %d completed (%d/%d workers done)\n", 
-                   source, completed_workers, numworkers);
+                   status.MPI_SOURCE, completed_workers, numworkers);
             fflush(stdout);
         }
+        free(reqs);
         
         t2 = MPI_Wtime();
         
@@ -111,71 +420,49 @@ int main(int argc, char **argv)
         printf("================================\n");
         printf("⏱️  Total time: %.2f seconds\n", t2 - t1);
         printf("🚀 Performance: %.2f GFLOPS\n", (2.0 * N * N * N) / (t2 - t1) / 1e9);
-        printf("💻 Speedup with %d workers: ~%.1fx\n", numworkers, (double)numworkers * 0.8);
-        
-        // Verification
-        printf("\n🔍 VERIFICATION:\n");
-        printf("   c[0][0] = %.2f (expected: %.2f)\n", c[0][0], (double)N * 2.0);
-        printf("   c[N-1][N-1] = %.2f (expected: %.2f)\n", c[N-1][N-1], (double)N * 2.0);
-        
-        if (abs(c[0][0] - (double)N * 2.0) < 0.01) {
-            printf("✅ Result is CORRECT!\n");
-        } else {
-            printf("❌ Result is INCORRECT!\n");
-        }
-        printf("================================\n");
-    }
-    
-    /*---------------------------- worker ----------------------------*/
-    if (taskid > 0) {
-        // Enviar informação do nó para o master
-        printf("🔧 Worker %d starting on node: %s\n", taskid, processor_name);
-        fflush(stdout);
-        
-        source = 0;
-        MPI_Recv(&offset, 1, MPI_INT, source, 1, MPI_COMM_WORLD, &status);
-        MPI_Recv(&rows, 1, MPI_INT, source, 1, MPI_COMM_WORLD, &status);
-        MPI_Recv(&a, rows * N, MPI_DOUBLE, source, 1, MPI_COMM_WORLD, &status);
-        MPI_Recv(&b, N * N, MPI_DOUBLE, source, 1, MPI_COMM_WORLD, &status);
-        
-        printf("💼 Worker %d (%s): Processing %d rows (offset=%d)\n", 
-               taskid, processor_name, rows, offset);
-        printf("🔄 Worker %d: Starting computation...\n", taskid);
+        printf("💻 Processes used: %d (master + %d workers)\n", numtasks, numworkers);
         fflush(stdout);
-        
-        double worker_start = MPI_Wtime();
-        
-        /* Matrix multiplication with progress */
-        for (k = 0; k < N; k++) {
-            // Show progress every 400 columns for cluster
-            if (k % 400 == 0 && k > 0) {
-                printf("📊 Worker %d (%s): %.1f%% complete\n", 
-                       taskid, processor_name, (double)k/N * 100.0);
-                fflush(stdout);
-            }
-            
-            for (i = 0; i < rows; i++) {
-                c[i][k] = 0.0;
-                for (j = 0; j < N; j++) {
-                    c[i][k] = c[i][k] + a[i][j] * b[j][k];
-                }
-            }
-        }
-        
-        double worker_end = MPI_Wtime();
-        printf("✅ Worker %d (%s): Completed in %.2f seconds\n", 
-               taskid, processor_name, worker_end - worker_start);
-        printf("📤 Worker %d: Sending results to master...\n", taskid);
-        fflush(stdout);
-        
-        MPI_Send(&offset, 1, MPI_INT, 0, 2, MPI_COMM_WORLD);
-        MPI_Send(&rows, 1, MPI_INT, 0, 2, MPI_COMM_WORLD);
-        MPI_Send(&c, rows * N, MPI_DOUBLE, 0, 2, MPI_COMM_WORLD);
-        
+    } else {
         printf("🎯 Worker %d (%s): Mission accomplished!\n", taskid, processor_name);
         fflush(stdout);
     }
     
+    /* Verification: every rank checks the rows it computed (the master also the
+     * dynamic ones, which it holds in full), with x drawn from a seed the master
+     * picks at run time */
+    if (rounds > 0) {
+        int g0[2], g1[2], l0[2], nr = 1;
+        uint64_t seed = (uint64_t)(MPI_Wtime() * 1e6);
+        double tv = MPI_Wtime(), worst, tol = MK_FREIVALDS_TOL(N, DBL_EPSILON);
+        MPI_Bcast(&seed, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+        g0[0] = displs[taskid];
+        g1[0] = displs[taskid] + rows;
+        l0[0] = 0;               /* the master's slab is the top of its full a/c */
+        if (taskid == 0 && static_rows < N) {
+            g0[1] = l0[1] = static_rows;
+            g1[1] = N;
+            nr = 2;
+        }
+        worst = freivalds(N, rounds, seed, nr, g0, g1, l0, a, b, c);
+        tv = MPI_Wtime() - tv;
+        if (taskid == 0) {
+            printf("\n🔍 VERIFICATION (Freivalds, %d rounds, %.3f s):\n", rounds, tv);
+            printf("   max relative residual = %.3g (tolerance %.3g)\n", worst, tol);
+            if (worst <= tol)
+                printf("✅ Result is CORRECT!\n");
+            else
+                printf("❌ Result is INCORRECT!\n");
+            printf("================================\n");
+        }
+    }
+    
+    free(counts);
+    free(displs);
+    free(rate);
+    mk_matrix_free(a);
+    mk_matrix_free(b);
+    mk_matrix_free(c);
+    MPI_Type_free(&rowtype);
     MPI_Finalize();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,544 @@
+// naiaraprime_lmo_mpi.cpp
+// pi(x) pelo metodo combinatorio de Lagarias-Miller-Odlyzko (LMO), x de 64 bits,
+// distribuido entre ranks MPI e threads OpenMP.
+// Compile: mpicxx -O3 -march=native -fopenmp -std=c++17 -o naiaraprime_lmo_mpi naiaraprime_lmo_mpi.cpp
+// Execute: mpirun -np 4 ./naiaraprime_lmo_mpi 1e15 [-alpha A] [-blocks B] [-seg KB] [-check]
+//
+// Com y = alpha * x^(1/3) e a = pi(y):
+//   pi(x) = phi(x, a) + a - 1 - P2(x, a)
+// onde phi(x, a) conta os n <= x sem fator primo <= p_a (o termo P3 some porque
+// y >= x^(1/3)). Expandindo phi(x, b) = phi(x, b - 1) - phi(x / p_b, b - 1) ate as
+// folhas mu(n) phi(x / n, b):
+// - S1, folhas comuns: soma de mu(n) floor(x / n) para n <= y.
+// - S2, folhas especiais: -mu(m) phi(x / (p_b m), b - 1) com m <= y < p_b m e
+//   menor fator primo de m > p_b. Para b = 1, phi(z, 0) = z (direto); para b >= 2
+//   os z = x / (p_b m) < x / y sao respondidos por um crivo segmentado de [1, x / y]
+//   (so impares, um bit cada): para cada segmento e cada b, respondem-se as folhas
+//   de b que caem no segmento e depois riscam-se os multiplos de p_b. A contagem
+//   ate z vem de uma arvore de Fenwick sobre as palavras de 64 bits mais o popcount
+//   da palavra de z, e a contagem antes do segmento fica acumulada por b.
+// - P2: soma de pi(x / p) - pi(p) + 1 para y < p <= sqrt(x); os pi(x / p) saem de
+//   uma passada do crivo de crivo_segmentado.h por [0, x / y] com marcas em x / p.
+// Custo O(x^(2/3) log log x) contra O(x log log x) do crivo completo.
+//
+// Paralelizacao:
+// - S1 e S2 com b = 1: intervalos de n / m divididos entre ranks e threads.
+// - P2: blocos de [0, x / y] de custo estimado igual pela fila de crivo_fila; cada
+//   bloco conta os pi a partir do seu inicio e os totais dos blocos viram prefixos
+//   depois de um MPI_Allreduce.
+// - S2 (b >= 2): [1, x / y] e cortado em blocos pela mesma fila de crivo_fila (o
+//   rank 0 tambem criva blocos). Um bloco so conhece phi a partir do proprio
+//   inicio, entao devolve S (com as contagens locais), W[b] = soma de -mu(m) das
+//   folhas de b e T[b] = quantos numeros do bloco sobrevivem aos b - 1 primeiros
+//   primos; os resultados vao ao rank 0 num MPI_Gatherv e ele junta os blocos em
+//   ordem com S += S_k + soma_b W_k[b] * T_<k[b].
+//   Dentro do bloco as threads pegam sub-blocos contiguos e juntam do mesmo jeito.
+// -check compara com a contagem pelo crivo segmentado (crivo_conta_fila).
+
+#include <mpi.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "crivo_segmentado.h"
+
+struct Args {
+    uint64_t x = 1000000000000ULL;   // limite de pi(x)
+    double alpha = 0.0;              // y = alpha * x^(1/3) (0 = automatico, ln(x) / 5)
+    int blocks = 8;                  // blocos por rank em P2 e S2 (o S2 usa pelo menos 64)
+    size_t seg_bytes = 32 * 1024;    // segmento do crivo do S2 (bits de impares)
+    bool check = false;              // confere com o crivo segmentado
+};
+
+// Aceita inteiros e notacao cientifica (1e15)
+static uint64_t parse_x(const std::string& s) {
+    if (s.find_first_of("eE.") != std::string::npos)
+        return (uint64_t) std::llround(std::strtold(s.c_str(), nullptr));
+    return std::strtoull(s.c_str(), nullptr, 10);
+}
+
+Args parse_args(int argc, char** argv) {
+    Args a;
+    for (int i = 1; i < argc; ++i) {
+        std::string s = argv[i];
+        if (s == "-alpha" && i+1<argc) a.alpha = std::max(0.0, std::atof(argv[++i]));
+        else if (s == "-blocks" && i+1<argc) a.blocks = std::max(1, std::atoi(argv[++i]));
+        else if (s == "-seg" && i+1<argc) a.seg_bytes = (size_t) std::max(1, std::atoi(argv[++i])) * 1024;
+        else if (s == "-check") a.check = true;
+        else if (s[0] != '-') a.x = parse_x(s);
+    }
+    return a;
+}
+
+static int num_threads() {
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+// Maior r com r^3 <= n
+static uint64_t icbrt(uint64_t n) {
+    uint64_t r = (uint64_t) std::cbrt((double) n);
+    while (r * r * r > n) r--;
+    while ((r + 1) * (r + 1) * (r + 1) <= n) r++;
+    return r;
+}
+
+// mu(n) e menor fator primo de n, para n <= y
+struct Tabelas {
+    std::vector<int8_t> mu;
+    std::vector<uint32_t> lpf;
+};
+
+static Tabelas tabelas_ate(uint64_t y) {
+    Tabelas t;
+    t.mu.assign(y + 1, 1);
+    t.lpf.assign(y + 1, 0);
+    for (uint64_t p = 2; p <= y; p++) {
+        if (t.lpf[p]) continue;   // composto
+        for (uint64_t m = p; m <= y; m += p) {
+            if (!t.lpf[m]) t.lpf[m] = (uint32_t) p;
+            t.mu[m] = (int8_t) -t.mu[m];
+        }
+        for (uint64_t m = p * p; m <= y; m += p * p) t.mu[m] = 0;
+    }
+    t.lpf[1] = UINT32_MAX;   // 1 nao tem fator primo: passa em todo teste lpf > p
+    return t;
+}
+
+// ---------------- S2 (b >= 2): crivo de [lo, hi) com folhas ----------------
+
+// Resultado de um bloco do S2: S com phi contado a partir do inicio do bloco, e
+// W[b], T[b] para corrigir com o que veio antes (ver o cabecalho)
+struct Parcial {
+    int64_t S = 0;
+    std::vector<int64_t> W, T;
+};
+
+// Junta b (que vem logo depois de a) em a
+static void junta(Parcial& a, const Parcial& b) {
+    size_t n = std::max(a.W.size(), b.W.size());
+    a.W.resize(n, 0);
+    a.T.resize(n, 0);
+    a.S += b.S;
+    for (size_t i = 0; i < b.W.size(); i++) {
+        a.S += b.W[i] * a.T[i];
+        a.W[i] += b.W[i];
+        a.T[i] += b.T[i];
+    }
+}
+
+struct ContextoS2 {
+    uint64_t x, y;
+    int64_t a;                           // pi(y)
+    const std::vector<uint32_t>* primos; // primos ate sqrt(x); p_b = primos[b - 1]
+    const Tabelas* tab;
+    size_t seg_bits;
+    std::vector<uint64_t> limite;        // limite[b]: maior z possivel numa folha de b
+
+    uint64_t p(int64_t b) const { return (*primos)[(size_t) b - 1]; }
+};
+
+// Fenwick sobre contagens por palavra: prefixo(w) = bits nas palavras [0, w)
+struct Fenwick {
+    std::vector<int32_t> t;
+    void monta(const std::vector<uint64_t>& palavras) {
+        size_t n = palavras.size();
+        t.assign(n + 1, 0);
+        for (size_t i = 1; i <= n; i++) {
+            t[i] += __builtin_popcountll(palavras[i - 1]);
+            size_t pai = i + (i & (0 - i));
+            if (pai <= n) t[pai] += t[i];
+        }
+    }
+    void decrementa(size_t w) {
+        for (size_t i = w + 1; i < t.size(); i += i & (0 - i)) t[i]--;
+    }
+    int64_t prefixo(size_t w) const {
+        int64_t s = 0;
+        for (size_t i = w; i > 0; i -= i & (0 - i)) s += t[i];
+        return s;
+    }
+};
+
+// Crivo [lo, hi) (lo e hi pares) para as folhas com b >= 2
+static Parcial s2_bloco(const ContextoS2& c, uint64_t lo, uint64_t hi) {
+    Parcial r;
+    if (hi <= lo) return r;
+    // maior b com folhas em [lo, ...): limite[b] e praticamente decrescente; varre do fim
+    int64_t bmax = c.a - 1;
+    while (bmax >= 2 && c.limite[(size_t) bmax] < lo) bmax--;
+    if (bmax < 2) return r;
+    r.W.assign((size_t) bmax + 1, 0);
+    r.T.assign((size_t) bmax + 1, 0);
+
+    // proximo multiplo impar de p_b >= lo + 1 (o proprio p_b tambem e riscado)
+    std::vector<uint64_t> prox((size_t) bmax + 1);
+    for (int64_t b = 2; b <= bmax; b++) {
+        uint64_t p = c.p(b);
+        uint64_t m = (lo + 1 + p - 1) / p * p;
+        if (m % 2 == 0) m += p;
+        prox[(size_t) b] = m;
+    }
+
+    const std::vector<int8_t>& mu = c.tab->mu;
+    const std::vector<uint32_t>& lpf = c.tab->lpf;
+    std::vector<uint64_t> bits(c.seg_bits / 64);
+    Fenwick fw;
+
+    for (uint64_t seg_lo = lo; seg_lo < hi; seg_lo += 2 * c.seg_bits) {
+        const uint64_t seg_hi = std::min(hi, seg_lo + 2 * c.seg_bits);
+        const uint64_t nbits = (seg_hi - seg_lo) / 2;   // impares seg_lo + 1 + 2i
+        std::fill(bits.begin(), bits.end(), ~0ULL);
+        if (nbits % 64) bits[nbits / 64] = (1ULL << (nbits % 64)) - 1;
+        std::fill(bits.begin() + (nbits + 63) / 64, bits.end(), 0ULL);
+        bits.resize((nbits + 63) / 64);
+        fw.monta(bits);
+        int64_t vivos = (int64_t) nbits;
+
+        int64_t bseg = bmax;
+        while (bseg >= 2 && c.limite[(size_t) bseg] < seg_lo) bseg--;
+
+        // numeros sobreviventes em [seg_lo, z]
+        auto conta_ate = [&](uint64_t z) -> int64_t {
+            if (z <= seg_lo) return 0;
+            uint64_t i = (z - seg_lo - 1) / 2;   // ultimo bit <= z
+            uint64_t w = i / 64;
+            uint64_t masc = (i % 64 == 63) ? ~0ULL : ((1ULL << (i % 64 + 1)) - 1);
+            return fw.prefixo((size_t) w) + __builtin_popcountll(bits[w] & masc);
+        };
+
+        for (int64_t b = 2; b <= bseg; b++) {
+            const uint64_t p = c.p(b);
+            // folhas de b com z = x / (p m) em [seg_lo, seg_hi):
+            // m em (max(y / p, x / (p seg_hi)), min(y, x / (p seg_lo))]
+            uint64_t m_min = std::max(c.y / p, c.x / (p * seg_hi));
+            uint64_t m_max = seg_lo > 0 ? std::min(c.y, c.x / (p * seg_lo)) : c.y;
+            int64_t soma_mu = 0, s = 0;
+            if (p * p > c.y) {
+                // m <= y com menor fator > p > sqrt(y): m e primo
+                const std::vector<uint32_t>& pr = *c.primos;
+                auto i0 = std::upper_bound(pr.begin(), pr.end(), (uint32_t) std::max<uint64_t>(m_min, p));
+                auto i1 = std::upper_bound(pr.begin(), pr.end(), (uint32_t) m_max);
+                for (auto it = i0; it < i1; ++it) {
+                    uint64_t z = c.x / (p * *it);
+                    s += r.T[(size_t) b] + conta_ate(z);   // mu(m) = -1
+                    soma_mu++;
+                }
+            } else {
+                for (uint64_t m = m_max; m > m_min; m--) {
+                    if (mu[m] == 0 || lpf[m] <= p) continue;
+                    uint64_t z = c.x / (p * m);
+                    int64_t phi = r.T[(size_t) b] + conta_ate(z);
+                    s -= mu[m] * phi;
+                    soma_mu -= mu[m];
+                }
+            }
+            r.S += s;
+            r.W[(size_t) b] += soma_mu;
+            r.T[(size_t) b] += vivos;   // sobreviventes aos b - 1 primeiros primos
+
+            if (b == bseg) break;       // p_b so precisa ser riscado para os b seguintes
+            uint64_t j = prox[(size_t) b];
+            for (; j < seg_hi; j += 2 * p) {
+                uint64_t i = (j - seg_lo - 1) / 2;
+                uint64_t bit = 1ULL << (i % 64);
+                if (bits[i / 64] & bit) {
+                    bits[i / 64] &= ~bit;
+                    fw.decrementa((size_t) (i / 64));
+                    vivos--;
+                }
+            }
+            prox[(size_t) b] = j;
+        }
+        bits.resize(c.seg_bits / 64);
+    }
+    return r;
+}
+
+// Bloco do S2 dividido entre as threads em sub-blocos contiguos, juntados em ordem
+static Parcial s2_bloco_threads(const ContextoS2& c, uint64_t lo, uint64_t hi) {
+    int nt = num_threads();
+    std::vector<Parcial> partes(nt);
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static, 1)
+#endif
+    for (int t = 0; t < nt; t++) {
+        uint64_t a = lo + (hi - lo) / nt * t / 2 * 2;
+        uint64_t b = t == nt - 1 ? hi : lo + (hi - lo) / nt * (t + 1) / 2 * 2;
+        partes[t] = s2_bloco(c, a, b);
+    }
+    for (int t = 1; t < nt; t++) junta(partes[0], partes[t]);
+    return partes[0];
+}
+
+// ---------------- S2: distribuicao dos blocos e juncao em ordem ----------------
+
+// Fronteiras (pares) de nb blocos de [0, x / y] com custo estimado igual. As folhas
+// ficam em [x / y^2, x / y] e se concentram no comeco (densidade ~ 1 / z), o crivo
+// custa o mesmo por numero em todo o intervalo; medido em 1e12..1e15, meio a meio:
+//   C(z) = ln(1 + z / z0) / ln(1 + Z / z0) / 2 + z / Z / 2,  z0 = x / y^2, Z = x / y
+// Com pelo menos 64 blocos o maior fica abaixo de ~10% do S2.
+static std::vector<uint64_t> fronteiras_s2(uint64_t x, uint64_t y, uint64_t zmax, int nb) {
+    const double z0 = (double) x / ((double) y * (double) y), Z = (double) zmax + 1;
+    auto custo = [&](double z) { return 0.5 * std::log1p(z / z0) / std::log1p(Z / z0) + 0.5 * z / Z; };
+    std::vector<uint64_t> f(1, 0);
+    for (int k = 1; k < nb; k++) {
+        double lo = 0, hi = Z, q = (double) k / nb;
+        for (int it = 0; it < 64; it++) {
+            double meio = 0.5 * (lo + hi);
+            (custo(meio) < q ? lo : hi) = meio;
+        }
+        uint64_t v = (uint64_t) lo / 2 * 2;
+        if (v > f.back()) f.push_back(v);
+    }
+    f.push_back((zmax + 2) / 2 * 2);   // ultimo bloco inclui x / y
+    return f;
+}
+
+// Resultado de um bloco empacotado: [bloco, S, n, W[0..n), T[0..n)] (3 + 2n valores)
+static void empacota(int bloco, const Parcial& r, std::vector<int64_t>& v) {
+    v.push_back(bloco);
+    v.push_back(r.S);
+    v.push_back((int64_t) r.W.size());
+    v.insert(v.end(), r.W.begin(), r.W.end());
+    v.insert(v.end(), r.T.begin(), r.T.end());
+}
+
+static Parcial desempacota(const int64_t* v, int& bloco) {
+    Parcial r;
+    bloco = (int) v[0];
+    r.S = v[1];
+    size_t n = (size_t) v[2];
+    r.W.assign(v + 3, v + 3 + n);
+    r.T.assign(v + 3 + n, v + 3 + 2 * n);
+    return r;
+}
+
+// S2 com b >= 2 inteiro (valido no rank 0). Os blocos saem da fila de crivo_fila,
+// que tambem da blocos ao rank 0 entre um pedido e outro; cada rank empacota os
+// resultados dos seus blocos e no fim o rank 0 recebe todos com um MPI_Gatherv e
+// junta em ordem de bloco.
+static int64_t s2_distribuido(const ContextoS2& c, const std::vector<uint64_t>& f, MPI_Comm comm) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    const int nblocos = (int) f.size() - 1;
+
+    std::vector<int64_t> meus;
+    crivo_fila(comm, nblocos, [&](int k) { empacota(k, s2_bloco_threads(c, f[k], f[k + 1]), meus); });
+
+    int n = (int) meus.size();
+    std::vector<int> cont(size), desl(size, 0);
+    MPI_Gather(&n, 1, MPI_INT, cont.data(), 1, MPI_INT, 0, comm);
+    std::vector<int64_t> todos;
+    if (rank == 0) {
+        for (int r = 1; r < size; r++) desl[r] = desl[r - 1] + cont[r - 1];
+        todos.resize((size_t) desl[size - 1] + cont[size - 1]);
+    }
+    MPI_Gatherv(meus.data(), n, MPI_INT64_T, todos.data(), cont.data(), desl.data(), MPI_INT64_T, 0, comm);
+
+    Parcial total;
+    if (rank == 0) {
+        std::vector<Parcial> blocos(nblocos);
+        for (size_t pos = 0; pos < todos.size(); pos += 3 + 2 * (size_t) todos[pos + 2]) {
+            int k;
+            Parcial r = desempacota(todos.data() + pos, k);
+            blocos[k] = std::move(r);
+        }
+        for (int k = 0; k < nblocos; k++) junta(total, blocos[k]);
+    }
+    return total.S;
+}
+
+// ---------------- S1, S2 com b = 1 e P2 ----------------
+
+// Faixa [0, n) deste rank e desta thread (blocos contiguos)
+static void faixa(uint64_t n, int parte, int partes, uint64_t& i0, uint64_t& i1) {
+    i0 = n / partes * parte + std::min<uint64_t>(parte, n % partes);
+    i1 = i0 + n / partes + ((uint64_t) parte < n % partes ? 1 : 0);
+}
+
+// S1 + (S2 com b = 1) deste rank: soma de mu(n) floor(x / n), n <= y, e de
+// -mu(m) floor(x / (2m)) para y / 2 < m <= y, m impar
+static int64_t s1_local(uint64_t x, uint64_t y, const Tabelas& tab, int rank, int size) {
+    int64_t soma = 0;
+    uint64_t i0, i1;
+    faixa(y, rank, size, i0, i1);   // n = i + 1
+#ifdef _OPENMP
+    #pragma omp parallel for reduction(+:soma) schedule(static)
+#endif
+    for (uint64_t i = i0; i < i1; i++) {
+        uint64_t n = i + 1;
+        if (tab.mu[n]) soma += tab.mu[n] * (int64_t) (x / n);
+        if (n > y / 2 && (n & 1) && tab.mu[n]) soma -= tab.mu[n] * (int64_t) (x / (2 * n));
+    }
+    return soma;
+}
+
+// P2 = soma de pi(x / p) - pi(p) + 1 para y < p <= sqrt(x), a = pi(y).
+// pi(x / p) sai de crivo_conta com marcas nos x / p de cada bloco de [0, x / y];
+// os totais por bloco viram prefixos depois do Allreduce.
+static int64_t p2(uint64_t x, int64_t a, const std::vector<uint32_t>& primos, uint64_t zmax,
+                  int blocos_por_rank, MPI_Comm comm) {
+    int size;
+    MPI_Comm_size(comm, &size);
+    const std::vector<uint64_t> f = crivo_blocos(zmax, blocos_por_rank * size, primos);
+    const int nblocos = (int) f.size() - 1;
+    // por bloco: primos no bloco, soma das contagens locais nas marcas, numero de marcas
+    std::vector<int64_t> tot(nblocos, 0), soma(nblocos, 0), nm(nblocos, 0);
+    const int nt = num_threads();
+
+    crivo_fila(comm, nblocos, [&](int k) {
+        // marcas x / p em [f[k], f[k+1]) para p em (y, sqrt x]: p em (x / f[k+1], x / f[k]]
+        uint64_t p_max = f[k] > 0 ? x / f[k] : UINT64_MAX, p_min = x / f[k + 1];
+        auto i0 = std::upper_bound(primos.begin() + a, primos.end(), (uint32_t) std::min<uint64_t>(p_min, UINT32_MAX));
+        auto i1 = p_max >= primos.back() ? primos.end()
+                                         : std::upper_bound(primos.begin() + a, primos.end(), (uint32_t) p_max);
+        std::vector<uint64_t> marcas;
+        for (auto it = i1; it > i0; --it) marcas.push_back(x / *(it - 1));   // crescentes
+
+        // sub-blocos por thread (multiplos de 30), cada um com as suas marcas
+        std::vector<uint64_t> sub(nt + 1), cont(marcas.size());
+        std::vector<int64_t> sub_tot(nt, 0);
+        for (int t = 0; t <= nt; t++) sub[t] = t == nt ? f[k + 1] : f[k] + (f[k + 1] - f[k]) / nt * t / 30 * 30;
+#ifdef _OPENMP
+        #pragma omp parallel for schedule(static, 1)
+#endif
+        for (int t = 0; t < nt; t++) {
+            size_t m0 = std::lower_bound(marcas.begin(), marcas.end(), sub[t]) - marcas.begin();
+            size_t m1 = std::lower_bound(marcas.begin(), marcas.end(), sub[t + 1]) - marcas.begin();
+            sub_tot[t] = (int64_t) crivo_conta(sub[t], sub[t + 1], primos, CRIVO_SEGMENTO_BYTES,
+                                               marcas.data() + m0, m1 - m0, cont.data() + m0);
+        }
+        int64_t antes = 0;
+        for (int t = 0; t < nt; t++) {
+            size_t m0 = std::lower_bound(marcas.begin(), marcas.end(), sub[t]) - marcas.begin();
+            size_t m1 = std::lower_bound(marcas.begin(), marcas.end(), sub[t + 1]) - marcas.begin();
+            for (size_t i = m0; i < m1; i++) soma[k] += antes + (int64_t) cont[i];
+            antes += sub_tot[t];
+        }
+        tot[k] = antes;
+        nm[k] = (int64_t) marcas.size();
+    });
+    MPI_Allreduce(MPI_IN_PLACE, tot.data(), nblocos, MPI_INT64_T, MPI_SUM, comm);
+    MPI_Allreduce(MPI_IN_PLACE, soma.data(), nblocos, MPI_INT64_T, MPI_SUM, comm);
+    MPI_Allreduce(MPI_IN_PLACE, nm.data(), nblocos, MPI_INT64_T, MPI_SUM, comm);
+
+    int64_t r = 0, prefixo = 0;
+    for (int k = 0; k < nblocos; k++) {
+        r += soma[k] + nm[k] * prefixo;
+        prefixo += tot[k];
+    }
+    // - soma de pi(p) - 1 = k - 1 para o k-esimo primo, k = a + 1 .. pi(sqrt x)
+    const int64_t kmax = (int64_t) primos.size();
+    r -= (kmax * (kmax - 1) - a * (a - 1)) / 2;
+    return r;
+}
+
+int main(int argc, char** argv) {
+    int provided, rank, size;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    Args args = parse_args(argc, argv);
+    const uint64_t x = args.x;
+
+    if (x > 100000000000000000ULL) {
+        if (rank == 0) std::printf("x ate 1e17 (as somas parciais do S2 usam 64 bits)\n");
+        MPI_Finalize();
+        return 1;
+    }
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    double t0 = MPI_Wtime();
+    std::vector<uint32_t> primos = crivo_primos_base(x, MPI_COMM_WORLD);
+    int64_t pi_x = 0, S1 = 0, S2 = 0, P2 = 0;
+    uint64_t y = 0;
+    int64_t a = 0;
+    double t_s1 = 0, t_s2 = 0, t_p2 = 0;
+
+    if (x < 1000000) {
+        // pequeno: o crivo direto ja e instantaneo
+        uint64_t local = crivo_conta_fila(x, primos, MPI_COMM_WORLD, args.blocks);
+        uint64_t soma = 0;
+        MPI_Reduce(&local, &soma, 1, MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+        pi_x = (int64_t) soma;
+    } else {
+        // y = alpha x^(1/3), entre x^(1/3) e sqrt(x) / 2 (P2 precisa de y < sqrt x)
+        double alpha = args.alpha > 0 ? args.alpha : std::max(1.0, std::log((double) x) / 5.0);
+        const uint64_t c = icbrt(x);
+        y = std::max<uint64_t>(c, (uint64_t) (alpha * (double) c));
+        y = std::min<uint64_t>(y, crivo_isqrt(x) / 2);
+        a = (int64_t) (std::upper_bound(primos.begin(), primos.end(), (uint32_t) y) - primos.begin());
+        const uint64_t zmax = x / y;
+        Tabelas tab = tabelas_ate(y);
+
+        double t = MPI_Wtime();
+        int64_t s1 = s1_local(x, y, tab, rank, size);
+        MPI_Reduce(&s1, &S1, 1, MPI_INT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+        t_s1 = MPI_Wtime() - t;
+
+        t = MPI_Wtime();
+        ContextoS2 ctx;
+        ctx.x = x;
+        ctx.y = y;
+        ctx.a = a;
+        ctx.primos = &primos;
+        ctx.tab = &tab;
+        ctx.seg_bits = std::max<size_t>(64, args.seg_bytes * 8 / 64 * 64);
+        ctx.limite.assign((size_t) a + 1, 0);
+        for (int64_t b = 2; b < a; b++) {
+            uint64_t p = ctx.p(b), m = std::max<uint64_t>(ctx.p(b + 1), y / p + 1);
+            ctx.limite[(size_t) b] = x / (p * m);
+        }
+        int nb = std::max(64, args.blocks * std::max(1, size - 1));
+        S2 = s2_distribuido(ctx, fronteiras_s2(x, y, zmax, nb), MPI_COMM_WORLD);
+        t_s2 = MPI_Wtime() - t;
+
+        t = MPI_Wtime();
+        P2 = p2(x, a, primos, zmax, args.blocks, MPI_COMM_WORLD);
+        t_p2 = MPI_Wtime() - t;
+
+        pi_x = S1 + S2 + a - 1 - P2;
+    }
+    double t_total = MPI_Wtime() - t0;
+
+    int64_t pi_crivo = -1;
+    double t_crivo = 0;
+    if (args.check) {
+        double t = MPI_Wtime();
+        uint64_t local = crivo_conta_fila(x, primos, MPI_COMM_WORLD, args.blocks), soma = 0;
+        MPI_Reduce(&local, &soma, 1, MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+        pi_crivo = (int64_t) soma;
+        t_crivo = MPI_Wtime() - t;
+    }
+
+    if (rank == 0) {
+        std::printf("pi(x) por LMO | x = %llu | %d ranks x %d threads\n",
+                    (unsigned long long) x, size, num_threads());
+        if (y > 0) {
+            std::printf("y = %llu, a = pi(y) = %lld, crivo do S2 e do P2 ate x/y = %llu\n",
+                        (unsigned long long) y, (long long) a, (unsigned long long) (x / y));
+            std::printf("S1 + S2(b=1) = %lld (%.3f s) | S2(b>=2) = %lld (%.3f s) | P2 = %lld (%.3f s)\n",
+                        (long long) S1, t_s1, (long long) S2, t_s2, (long long) P2, t_p2);
+        }
+        std::printf("pi(%llu) = %lld\n", (unsigned long long) x, (long long) pi_x);
+        std::printf("Tempo: %.3f s\n", t_total);
+        if (args.check)
+            std::printf("Conferencia pelo crivo segmentado: %lld (%.3f s) %s\n", (long long) pi_crivo, t_crivo,
+                        pi_crivo == pi_x ? "OK" : "DIFERENTE");
+    }
+    MPI_Finalize();
+    return 0;
+}
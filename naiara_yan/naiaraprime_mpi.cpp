@@ -4,28 +4,47 @@
 #include <iomanip>
 #include <iostream>
 #include <mpi.h>
+#include "crivo_segmentado.h"
 using namespace std;
 
+/* Usage: mpirun -np P ./naiaraprime_mpi [N_HI] [SEGMENT_KB] [BLOCKS_PER_RANK]
+ * Counts pi(n) for n = 1, 2, 4, ..., N_HI (default 1048576) with a segmented sieve
+ * (crivo_segmentado.h) on a mod-30 wheel (one byte per 30 numbers), with the base
+ * primes up to sqrt(N_HI) computed once on rank 0 and broadcast. SEGMENT_KB
+ * (default 32, the L1 size) sets the bytes sieved at a time.
+ * [0, n] is cut into BLOCKS_PER_RANK * P contiguous blocks of equal estimated cost
+ * (default 8 per rank) that rank 0 hands out on request; 0 gives every rank one
+ * fixed contiguous block instead. */
+
 int main(int argc, char *argv[]);
-int prime_number(int n, int id, int p);
+long long prime_number(long long n, int id, int p, const vector<uint32_t> &base, size_t seg_bytes,
+                       int blocks);
 void timestamp();
 
 int main(int argc, char *argv[])
 {
     int id;
     int ierr;
-    int n;
+    long long n;
     int n_factor;
-    int n_hi;
-    int n_lo;
+    long long n_hi;
+    long long n_lo;
     int p;
-    int primes;
-    int primes_part;
+    long long primes;
+    long long primes_part;
     double wtime;
+    size_t seg_bytes = CRIVO_SEGMENTO_BYTES;
+    int blocks = 8;
     
     n_lo = 1;
     n_hi = 1048576;
     n_factor = 2;
+    if (argc > 1)
+        n_hi = atoll(argv[1]);
+    if (argc > 2 && atoi(argv[2]) > 0)
+        seg_bytes = (size_t)atoi(argv[2]) * 1024;
+    if (argc > 3 && atoi(argv[3]) >= 0)
+        blocks = atoi(argv[3]);
     
     // Initialize MPI
     ierr = MPI_Init(&argc, &argv);
@@ -50,20 +69,23 @@ int main(int argc, char *argv[])
         cout << " N Pi Time\n\n";
     }
     
+    // base primes for the largest n, shared by every smaller one
+    vector<uint32_t> base = crivo_primos_base((uint64_t)n_hi, MPI_COMM_WORLD);
+    
     n = n_lo;
     while (n <= n_hi) {
         if (id == 0) {
             wtime = MPI_Wtime();
         }
         
-        ierr = MPI_Bcast(&n, 1, MPI_INT, 0, MPI_COMM_WORLD);
-        primes_part = prime_number(n, id, p);
-        ierr = MPI_Reduce(&primes_part, &primes, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+        ierr = MPI_Bcast(&n, 1, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+        primes_part = prime_number(n, id, p, base, seg_bytes, blocks);
+        ierr = MPI_Reduce(&primes_part, &primes, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
         
         if (id == 0) {
             wtime = MPI_Wtime() - wtime;
-            cout << " " << setw(8) << n
-                 << " " << setw(8) << primes
+            cout << " " << setw(12) << n
+                 << " " << setw(12) << primes
                  << " " << setw(14) << wtime << "\n";
         }
         n = n * n_factor;
@@ -81,25 +103,16 @@ int main(int argc, char *argv[])
     return 0;
 }
 
-int prime_number(int n, int id, int p)
+// primes in the blocks of [0, n] this rank sieved, taken from rank 0's queue when
+// blocks > 0 or as one fixed contiguous share otherwise; base holds the primes up to sqrt(n)
+long long prime_number(long long n, int id, int p, const vector<uint32_t> &base, size_t seg_bytes,
+                       int blocks)
 {
-    int i;
-    int j;
-    int prime;
-    int total;
-    
-    total = 0;
-    for (i = 2 + id; i <= n; i = i + p) {
-        prime = 1;
-        for (j = 2; j < i; j++) {
-            if ((i % j) == 0) {
-                prime = 0;
-                break;
-            }
-        }
-        total = total + prime;
-    }
-    return total;
+    if (n < 2)
+        return 0;
+    if (blocks > 0)
+        return (long long)crivo_conta_fila((uint64_t)n, base, MPI_COMM_WORLD, blocks, seg_bytes);
+    return (long long)crivo_conta_local((uint64_t)n, base, id, p, seg_bytes);
 }
 
 void timestamp()
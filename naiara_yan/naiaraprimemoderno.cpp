@@ -4,87 +4,59 @@
  * Este programa conta quantos números primos existem no intervalo [2, N]
  * utilizando processamento paralelo com MPI.
  *
- * Cada processo fica responsável por testar uma parte dos números,
- * evitando trabalho redundante (por exemplo, ignorando números pares)
- * e utilizando um teste de primalidade otimizado (divisões apenas até
- * a raiz quadrada do número).
+ * [0, N] é cortado em blocos contíguos de custo estimado igual, que o
+ * processo 0 entrega sob demanda (fila de trabalho), e cada bloco é
+ * contado com um crivo de Eratóstenes segmentado (crivo_segmentado.h): os
+ * primos até sqrt(N) são calculados uma vez pelo processo 0 e enviados a
+ * todos, e o bloco é crivado em segmentos que cabem na cache (32 KB por
+ * padrão) com uma roda mod 30 (8 candidatos por byte), pré-crivo dos
+ * primos até 17 e baldes para os primos grandes.
  *
  * Execução (exemplo):
- *   mpirun -np 4 ./primos_mpi 1000000
+ *   mpirun -np 4 ./primos_mpi 10000000000 [SEGMENTO_KB] [BLOCOS_POR_PROCESSO]
+ *
+ * BLOCOS_POR_PROCESSO (padrão 8) controla a granularidade da fila; com 0
+ * cada processo crivo um único bloco fixo.
  *
  * Se N não for informado na linha de comando, é usado um valor padrão.
  */
 
 #include <mpi.h>
 #include <iostream>
-#include <cmath>
-#include <cstdlib> // std::atoi
-
-// ---------------------------------------------------------------------------
-// Função: is_prime
-// Propósito:
-//   Verificar se um número inteiro n é primo de forma eficiente.
-// Estratégia:
-//   - Números menores que 2 não são primos.
-//   - 2 é primo.
-//   - Números pares maiores que 2 não são primos.
-//   - Para ímpares, testa divisores ímpares de 3 até sqrt(n).
-// ---------------------------------------------------------------------------
-bool is_prime(int n)
-{
-    if (n < 2) return false;
-    if (n == 2) return true;
-    if (n % 2 == 0) return false;
-
-    int limit = static_cast<int>(std::sqrt(static_cast<double>(n)));
-    for (int d = 3; d <= limit; d += 2)
-    {
-        if (n % d == 0)
-            return false;
-    }
-    return true;
-}
+#include <cstdlib> // std::atoll
+#include <vector>
+#include "crivo_segmentado.h"
 
 // ---------------------------------------------------------------------------
 // Função: count_primes_local
 // Propósito:
-//   Calcular, em cada processo MPI, quantos números primos existem no
-//   intervalo [2, n], considerando apenas o subconjunto de números
-//   atribuídos àquele processo.
-// Estratégia de distribuição:
-//   - O número primo 2 é tratado separadamente (processo 0).
-//   - Cada processo verifica apenas números ímpares.
-//   - Para evitar sobreposição, usamos:
-//       início = 3 + 2 * rank
-//       passo  = 2 * size
-//     Assim, cada processo anda em "saltos" diferentes dentro da
-//     sequência de ímpares.
+//   Calcular, em cada processo MPI, quantos números primos existem nos
+//   blocos de [2, n] crivados por aquele processo (o 2 incluído, em quem
+//   crivar o primeiro bloco).
+// Estratégia:
+//   - Com blocos > 0, [0, n] é cortado em blocos * size blocos contíguos
+//     de custo estimado igual (blocos altos têm mais primos base), e o
+//     processo 0 entrega o próximo bloco a quem pedir.
+//   - Com blocos == 0, cada processo fica com um único bloco fixo de
+//     tamanho (quase) igual.
+//   - Cada bloco é crivado por segmentos de seg_bytes bytes, cada byte com
+//     os 8 números de 30 que são primos com 2, 3 e 5, riscando os múltiplos
+//     dos primos base (ver crivo_segmentado.h).
 //
 // Parâmetros:
-//   - n     : limite superior do intervalo [2, n].
-//   - rank  : identificador do processo (0, 1, ..., size-1).
-//   - size  : número total de processos MPI.
-//
-// Retorno:
-//   - quantidade de números primos encontrados pelo processo.
+//   - n         : limite superior do intervalo [2, n].
+//   - primos    : primos até sqrt(n), iguais em todos os processos.
+//   - rank/size : identificador do processo e número de processos.
+//   - seg_bytes : tamanho do segmento do crivo.
+//   - blocos    : blocos da fila por processo (0 = divisão fixa).
 // ---------------------------------------------------------------------------
-int count_primes_local(int n, int rank, int size)
+long long count_primes_local(long long n, const std::vector<uint32_t>& primos,
+                             int rank, int size, size_t seg_bytes, int blocos)
 {
-    int local_count = 0;
-
-    // Cada processo percorre apenas um subconjunto dos números ímpares.
-    int start = 3 + 2 * rank;      // primeiro ímpar atribuído a este rank
-    int step  = 2 * size;          // salto entre números ímpares para este rank
-
-    for (int value = start; value <= n; value += step)
-    {
-        if (is_prime(value))
-        {
-            local_count++;
-        }
-    }
-
-    return local_count;
+    const uint64_t un = static_cast<uint64_t>(n);
+    return static_cast<long long>(
+        blocos > 0 ? crivo_conta_fila(un, primos, MPI_COMM_WORLD, blocos, seg_bytes)
+                   : crivo_conta_local(un, primos, rank, size, seg_bytes));
 }
 
 int main(int argc, char* argv[])
@@ -101,13 +73,14 @@ int main(int argc, char* argv[])
     // - Processo 0 lê N da linha de comando (se existir) ou define padrão.
     // - Em seguida, N é disseminado para todos com MPI_Bcast.
     // -----------------------------------------------------------------------
-    int n = 1000000; // valor padrão
+    long long n = 1000000; // valor padrão
+    size_t seg_bytes = CRIVO_SEGMENTO_BYTES;
 
     if (rank == 0)
     {
         if (argc >= 2)
         {
-            n = std::atoi(argv[1]);
+            n = std::atoll(argv[1]);
             if (n < 2)
             {
                 std::cerr << "Valor de N invalido. Usando N = 1000000.\n";
@@ -120,7 +93,15 @@ int main(int argc, char* argv[])
     }
 
     // Todos os processos recebem o mesmo valor de n.
-    MPI_Bcast(&n, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&n, 1, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+
+    // Tamanho do segmento em KB e blocos por processo (opcionais); todos
+    // leem o mesmo argv.
+    if (argc >= 3 && std::atoi(argv[2]) > 0)
+        seg_bytes = static_cast<size_t>(std::atoi(argv[2])) * 1024;
+    int blocos = 8;
+    if (argc >= 4 && std::atoi(argv[3]) >= 0)
+        blocos = std::atoi(argv[3]);
 
     // Sincroniza todos antes de começar a contagem (para o tempo ficar coerente).
     MPI_Barrier(MPI_COMM_WORLD);
@@ -128,21 +109,16 @@ int main(int argc, char* argv[])
 
     // -----------------------------------------------------------------------
     // Cálculo local de primos
-    // - Processo 0 trata o primo 2 (se estiver dentro do intervalo).
-    // - Cada processo conta seus primos ímpares com count_primes_local.
+    // - Primos base até sqrt(n): calculados no processo 0 e transmitidos
+    //   (entram no tempo medido).
+    // - Cada processo conta os primos dos seus blocos com count_primes_local.
     // -----------------------------------------------------------------------
-    int local_count = count_primes_local(n, rank, size);
-
-    // Processo 0 adiciona o primo 2, se n >= 2
-    int base_primes = 0;
-    if (rank == 0 && n >= 2)
-    {
-        base_primes = 1; // contando o 2
-    }
+    std::vector<uint32_t> primos = crivo_primos_base(static_cast<uint64_t>(n), MPI_COMM_WORLD);
+    long long local_count = count_primes_local(n, primos, rank, size, seg_bytes, blocos);
 
     // Soma global dos resultados locais
-    int global_count = 0;
-    MPI_Reduce(&local_count, &global_count, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+    long long global_count = 0;
+    MPI_Reduce(&local_count, &global_count, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
 
     double t_end = MPI_Wtime();
     double elapsed = t_end - t_start;
@@ -152,9 +128,7 @@ int main(int argc, char* argv[])
     // -----------------------------------------------------------------------
     if (rank == 0)
     {
-        int total_primes = global_count + base_primes;
-
-        std::cout << "Total de numeros primos encontrados: " << total_primes << "\n";
+        std::cout << "Total de numeros primos encontrados: " << global_count << "\n";
         std::cout << "Tempo de execucao: " << elapsed << " segundos.\n";
     }
 